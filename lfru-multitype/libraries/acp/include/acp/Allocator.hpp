@@ -5,12 +5,31 @@
 #include <cstdint>
 #include <initializer_list>
 #include <utility>
+#include <vector>
 
 #include "acp/Pool.hpp"
+#include "acp/PoolStdAllocator.hpp"
 
 class AllocatorWithPool: private PoolAllocator {
 public:
-    AllocatorWithPool(std::size_t const size, std::initializer_list<std::size_t> sizes);
+    AllocatorWithPool(std::size_t const size, std::initializer_list<std::size_t> sizes,
+                      std::size_t const max_empty_slabs = 1);
+
+    AllocatorWithPool(std::size_t const size, std::vector<std::size_t> sizes, std::size_t const max_empty_slabs = 1);
+
+    using PoolAllocator::enable_huge_pages;
+    using PoolAllocator::enable_shared_mode;
+    using PoolAllocator::occupancy;
+#ifdef ACP_POOL_STATS
+    using PoolAllocator::profile;
+#endif
+    using PoolAllocator::set_decay_time;
+
+    // Lets standard containers place their nodes in the same pool.
+    template <class T>
+    PoolStdAllocator<T> std_allocator() {
+        return PoolStdAllocator<T>(*this);
+    }
 
     template <class T, class... Args>
     T *create(Args &&...args) {
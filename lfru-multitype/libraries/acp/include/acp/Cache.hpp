@@ -1,86 +1,1103 @@
 #ifndef ACP_CACHE_HPP
 #define ACP_CACHE_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <concepts>
 #include <cstddef>
-#include <list>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <new>
+#include <optional>
 #include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template <class Key, class KeyProvider, class Allocator>
+#include "acp/FrequencySketch.hpp"
+#include "acp/TimerWheel.hpp"
+
+struct CacheStats {
+    std::size_t priority_hits = 0;
+    std::size_t regular_hits = 0;
+    std::size_t misses = 0;
+    std::size_t promotions = 0;
+    std::size_t demotions = 0;
+    std::size_t evictions = 0;
+    std::size_t rejections = 0;
+    std::size_t expirations = 0;
+
+    std::size_t hits() const { return priority_hits + regular_hits; }
+
+    std::size_t lookups() const { return hits() + misses; }
+
+    double hit_ratio() const { return lookups() == 0 ? 0.0 : static_cast<double>(hits()) / lookups(); }
+
+    CacheStats &operator+=(const CacheStats &other) {
+        priority_hits += other.priority_hits;
+        regular_hits += other.regular_hits;
+        misses += other.misses;
+        promotions += other.promotions;
+        demotions += other.demotions;
+        evictions += other.evictions;
+        rejections += other.rejections;
+        expirations += other.expirations;
+        return *this;
+    }
+
+    friend std::ostream &operator<<(std::ostream &strm, const CacheStats &stats) {
+        return strm << "hits: " << stats.hits() << " (priority " << stats.priority_hits << ", regular "
+                    << stats.regular_hits << "), misses: " << stats.misses << ", hit ratio: " << stats.hit_ratio()
+                    << ", promotions: " << stats.promotions << ", demotions: " << stats.demotions
+                    << ", evictions: " << stats.evictions << ", rejections: " << stats.rejections
+                    << ", expirations: " << stats.expirations;
+    }
+};
+
+// Why an object left the cache: pushed out by newer ones, past its expiry time, or dropped with all others when the
+// cache was destroyed or reloaded.
+enum class RemovalCause : unsigned char { Evicted, Expired, Cleared };
+
+// Objects that report their own weight (e.g. their footprint in bytes) are accounted by it; all others weigh 1.
+template <class T>
+concept Weighted = requires(const T &object) {
+    { object.weight() } -> std::convertible_to<std::size_t>;
+};
+
+// A key of another type than the cache's own is looked up as is when the hash is transparent, i.e. hashes it like
+// the equal Key, and the cached objects compare equal to it.
+template <class K, class Key, class Hash>
+concept LookupKey = !std::same_as<K, Key> && requires(const Hash &hash, const K &key) {
+    typename Hash::is_transparent;
+    { hash(key) } -> std::convertible_to<std::size_t>;
+};
+
+// Transparent hash for std::string keys: string views and literals are hashed without building a std::string.
+struct StringHash {
+    using is_transparent = void;
+
+    std::size_t operator()(const std::string_view key) const { return std::hash<std::string_view>{}(key); }
+};
+
+template <class Key, class KeyProvider, class Allocator, class Hash = std::hash<Key>>
 class Cache {
+    enum class Segment : unsigned char { Priority, Regular };
+
+    // Every cached object is preceded by this header in the same pool slot: segment links, hash chain, timer
+    // links and the type-erased destructor, so neither a hit nor a promotion touches the global heap.
+    struct Entry {
+        Entry *prev;
+        Entry *next;
+        Entry *chain;
+        std::size_t hash;
+        std::size_t weight;
+        KeyProvider *value;
+        void (*drop)(Allocator &, Entry *);
+        Segment segment;
+        bool dirty;
+        std::uint16_t timer_slot;
+        std::uint32_t type;
+        std::uint64_t expires;
+        Entry *timer_prev;
+        Entry *timer_next;
+    };
+
+    template <class T>
+    struct Node : Entry {
+        T object;
+
+        template <class... Args>
+        explicit Node(Args &&...args) : Entry(), object(std::forward<Args>(args)...) {
+            this->value = &object;
+            this->type = type_id<T>();
+            if constexpr (Weighted<T>) {
+                this->weight = object.weight();
+            } else {
+                this->weight = 1;
+            }
+            this->drop = [](Allocator &alloc, Entry *entry) {
+                alloc.template destroy<Node>(static_cast<Node *>(entry));
+            };
+        }
+    };
+
+    class List {
+    public:
+        Entry *front() const { return m_head; }
+        Entry *back() const { return m_tail; }
+        std::size_t size() const { return m_size; }
+        std::size_t weight() const { return m_weight; }
+
+        void push_front(Entry *entry) {
+            entry->prev = nullptr;
+            entry->next = m_head;
+            if (m_head != nullptr) {
+                m_head->prev = entry;
+            } else {
+                m_tail = entry;
+            }
+            m_head = entry;
+            ++m_size;
+            m_weight += entry->weight;
+        }
+
+        void push_back(Entry *entry) {
+            entry->prev = m_tail;
+            entry->next = nullptr;
+            if (m_tail != nullptr) {
+                m_tail->next = entry;
+            } else {
+                m_head = entry;
+            }
+            m_tail = entry;
+            ++m_size;
+            m_weight += entry->weight;
+        }
+
+        void erase(Entry *entry) {
+            (entry->prev != nullptr ? entry->prev->next : m_head) = entry->next;
+            (entry->next != nullptr ? entry->next->prev : m_tail) = entry->prev;
+            --m_size;
+            m_weight -= entry->weight;
+        }
+
+    private:
+        Entry *m_head = nullptr;
+        Entry *m_tail = nullptr;
+        std::size_t m_size = 0;
+        std::size_t m_weight = 0;
+    };
+
+    // A pair of segments with their budgets. Types without a quota share the first one.
+    struct Partition {
+        List lfu;
+        List queue;
+        std::size_t max_top_size;
+        std::size_t max_low_size;
+    };
+
+    // Every cached type gets a distinct id, stored in its entries.
+    static std::uint32_t next_type_id() {
+        static std::atomic<std::uint32_t> count{0};
+        return count.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    template <class T>
+    static std::uint32_t type_id() {
+        static const std::uint32_t id = next_type_id();
+        return id;
+    }
+
 public:
+    using Clock = std::chrono::steady_clock;
+    using RemovalListener = std::function<void(KeyProvider &, RemovalCause, bool)>;
+
+    // `cache_size` is the budget of each segment: a number of entries, or the total weight() of the stored objects.
     template <class... AllocArgs>
     Cache(const std::size_t cache_size, AllocArgs &&...alloc_args)
-        : m_max_top_size(cache_size)
-        , m_max_low_size(cache_size)
+        : m_cache_size(cache_size)
         , m_alloc(std::forward<AllocArgs>(alloc_args)...)
-        , lfu()
-        , queue() {}
+        , m_buckets(std::bit_ceil(std::min<std::size_t>(2 * cache_size, 1 << 16) + 1))
+        , m_partitions{Partition{List(), List(), cache_size, cache_size}}
+        , m_partition_of()
+        , m_stats()
+        , m_admission(false)
+        , m_sketch()
+        , m_bypass(nullptr)
+        , m_climber()
+        , m_batching(false)
+        , m_timers()
+        , m_time_to_live()
+        , m_listener()
+        , m_typed_listeners() {}
+
+    Cache(const Cache &) = delete;
+    Cache &operator=(const Cache &) = delete;
+
+    ~Cache() { clear(); }
 
-    std::size_t size() const { return lfu.size() + queue.size(); }
+    // Size of the pool slot a cached T occupies, to be passed to the allocator's size list.
+    template <class T>
+    static constexpr std::size_t entry_size() {
+        return sizeof(Node<T>);
+    }
+
+    // Size list giving each of the types a class that fits its entries exactly, so that none wastes the tail of a
+    // larger slot. Types whose entries have the same size still share a class, and with it slabs.
+    template <class... Ts>
+    static std::vector<std::size_t> entry_sizes() {
+        return {entry_size<Ts>()...};
+    }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (const Partition &partition : m_partitions) {
+            result += partition.lfu.size() + partition.queue.size();
+        }
+        return result;
+    }
 
     bool empty() const { return size() == 0; }
 
+    std::size_t weight() const {
+        std::size_t result = 0;
+        for (const Partition &partition : m_partitions) {
+            result += partition.lfu.weight() + partition.queue.weight();
+        }
+        return result;
+    }
+
+    const CacheStats &stats() const { return m_stats; }
+
+    Allocator &allocator() { return m_alloc; }
+
+    void reset_stats() { m_stats = CacheStats(); }
+
+    // TinyLFU admission: once the regular segment is full, a missed key replaces its tail only if it is estimated
+    // to be accessed more often. A rejected object is still returned, but lives outside the cache until the next miss.
+    void enable_admission_filter(const bool enable = true) {
+        m_admission = enable;
+        m_sketch.reset();
+    }
+
+    // Shifts capacity between the segments at runtime, keeping their total fixed: after every sample of lookups
+    // the split moves one step in the direction that last improved the hit ratio. Samples are ten lookups per cached
+    // entry, steps an eighth of the segment budget. Disabling restores an even split.
+    void enable_adaptive_split(const bool enable = true) {
+        m_climber.reset();
+        if (enable && m_cache_size > 0) {
+            m_climber.emplace(Climber{climb_sample(), 0, 0, -1.0, std::max<std::size_t>(1, m_cache_size / 8), 1});
+        } else {
+            resize_segments(m_cache_size);
+        }
+    }
+
+    // Entries inserted from now on expire `ttl` after insertion; zero disables expiry for new entries.
+    void set_time_to_live(const Clock::duration ttl) { m_time_to_live = ttl; }
+
+    // Sets or replaces the expiry time of the T cached for a key; returns false if there is none.
+    template <class T>
+    bool expire_at(const Key &key, const Clock::time_point when) {
+        Entry *entry = find(key, Hash{}(key), type_id<T>());
+        if (entry == nullptr) {
+            return false;
+        }
+        m_timers.cancel(entry);
+        entry->expires = ticks(when);
+        m_timers.schedule(entry);
+        return true;
+    }
+
+    // Releases every entry that is due at `now` back to the allocator and returns how many there were. Lookups do
+    // the same on their own whenever some entry has an expiry time.
+    std::size_t expire(const Clock::time_point now = Clock::now()) {
+        const std::size_t before = m_stats.expirations;
+        m_timers.advance(ticks(now), [this](Entry *entry) {
+            remove(entry, RemovalCause::Expired);
+            ++m_stats.expirations;
+        });
+        return m_stats.expirations - before;
+    }
+
+    // Called with every object leaving the cache and whether it was marked dirty, right before the object is
+    // destroyed, so it may move the contents out. It runs on the thread that caused the removal, inside get(), and must
+    // not block: slow persistence belongs in a WriteBack, fed with try_push(). Objects rejected by the admission filter
+    // were never cached and are not reported.
+    void set_removal_listener(RemovalListener listener) { m_listener = std::move(listener); }
+
+    // Like the listener above, but only for objects cached as T, which it gets as a T. Takes their removals over from
+    // the general listener, so that one cached under several types can be told apart.
     template <class T>
-    T &get(const Key &key);
+    void set_removal_listener(std::function<void(T &, RemovalCause, bool)> listener) {
+        const std::uint32_t type = type_id<T>();
+        if (type >= m_typed_listeners.size()) {
+            m_typed_listeners.resize(type + 1);
+        }
+        if (listener) {
+            m_typed_listeners[type] = [listener = std::move(listener)](KeyProvider &value, const RemovalCause cause,
+                                                                       const bool dirty) {
+                listener(static_cast<T &>(value), cause, dirty);
+            };
+        } else {
+            m_typed_listeners[type] = nullptr;
+        }
+    }
+
+    // Flags the T cached for a key as modified since it was loaded; returns false if there is none.
+    template <class T>
+    bool mark_dirty(const Key &key) {
+        Entry *entry = find(key, Hash{}(key), type_id<T>());
+        if (entry == nullptr) {
+            return false;
+        }
+        entry->dirty = true;
+        return true;
+    }
+
+    // Budgets of the shared segments.
+    std::size_t priority_capacity() const { return m_partitions.front().max_top_size; }
+
+    std::size_t regular_capacity() const { return m_partitions.front().max_low_size; }
+
+    // Gives objects of type T segments of their own, each with a budget of `cache_size`, on top of the shared ones:
+    // a type of large or churning objects then only ever evicts its own kind. Objects of T already cached move over
+    // in their recency order; calling it again changes the budget.
+    template <class T>
+    void set_quota(const std::size_t cache_size);
+
+    // Objects are cached per type: get<A>(key) never returns, or even compares against, an object cached by
+    // get<B>(key), the two are separate entries. On a miss T is constructed from the key right in its pool slot.
+    template <class T>
+    T &get(const Key &key) {
+        return get<T>(key, Hash{}(key));
+    }
+
+    template <class T, class K>
+        requires LookupKey<K, Key, Hash>
+    T &get(const K &key) {
+        return get<T>(key, Hash{}(key));
+    }
+
+    // Lookup with a hash the caller has already computed as Hash{}(key).
+    template <class T, class K>
+    T &get(const K &key, const std::size_t hash) {
+        if (T *value = lookup<T>(key, hash)) {
+            return *value;
+        }
+        return emplace<T>(key, hash, key);
+    }
+
+    // Read-through lookup: on a miss the object is built from `loader(key)` instead of from the key itself.
+    template <class T, class Loader>
+    T &get_or_load(const Key &key, Loader &&loader) {
+        const std::size_t hash = Hash{}(key);
+        if (T *value = lookup<T>(key, hash)) {
+            return *value;
+        }
+        return emplace<T>(key, hash, std::invoke(std::forward<Loader>(loader), key));
+    }
+
+    // Counts an access and, on a hit, moves the entry to the head of the priority segment. A miss inserts nothing.
+    template <class T, class K>
+    T *lookup(const K &key, std::size_t hash);
+
+    // Caches an object built from `args` for a key found missing by lookup(); if the key got cached in between, the
+    // existing object is kept.
+    template <class T, class K, class... Args>
+    T &emplace(const K &key, const std::size_t hash, Args &&...args) {
+        drop_bypass();
+        return add<T>(std::numeric_limits<std::size_t>::max(), key, hash, std::forward<Args>(args)...);
+    }
+
+    // Batched get: each group of keys is hashed and its buckets and chain heads are prefetched before any entry is
+    // compared, then the keys are served in order, `out[i]` receiving the object for `keys[i]`. Returns how many keys
+    // were served: the batch stops before a key whose promotion or insertion could push out an object it already
+    // handed out, so every served `out[i]` stays valid until the next lookup; callers pass the rest again. A weighted
+    // miss that turns out heavier than what is left is handed out uncached, like a rejected object, and ends the
+    // batch. Expired entries are dropped once before the batch and the adaptive split only moves between batches.
+    // Throws std::invalid_argument if `out` is shorter than `keys`.
+    template <class T>
+    std::size_t get_many(std::span<const Key> keys, std::span<T *> out);
+
+    // Writes the keys of both segments, most recent first, to a snapshot for load(). Every entry must be a T and
+    // `key_of(object)` has to return its key; keys are written as raw bytes if trivially copyable and as a length
+    // followed by the elements otherwise (strings). With `with_values` the objects themselves are written too, which
+    // requires a trivially copyable T that holds no pointers. The snapshot goes to `path` + ".tmp" first and only
+    // replaces `path` once completely written; failures throw std::runtime_error or std::filesystem::filesystem_error.
+    template <class T, class KeyOf>
+    void save(const std::filesystem::path &path, KeyOf &&key_of, bool with_values = false) const;
+
+    // Replaces the contents with a snapshot written by save<T>(), restoring both segments in their recency order.
+    // Objects that were not saved are built from their keys as on a miss; entries beyond the current segment
+    // capacities are skipped, and time to live starts over. Statistics are left untouched. A snapshot that is
+    // truncated or corrupt throws std::runtime_error and leaves the cache as it was.
+    template <class T>
+    void load(const std::filesystem::path &path);
 
     std::ostream &print(std::ostream &strm) const;
 
     friend std::ostream &operator<<(std::ostream &strm, const Cache &cache) { return cache.print(strm); }
 
 private:
-    const std::size_t m_max_top_size;
-    const std::size_t m_max_low_size;
+    struct Climber {
+        std::size_t sample;
+        std::size_t lookups;
+        std::size_t hits;
+        double previous_rate;
+        std::size_t step;
+        int direction;
+    };
+
+    const std::size_t m_cache_size;
     Allocator m_alloc;
-    std::list<KeyProvider *> lfu;
-    std::list<KeyProvider *> queue;
+    std::vector<Entry *> m_buckets;
+    std::vector<Partition> m_partitions;
+    // Partition index by type id, for types with a quota.
+    std::vector<std::uint16_t> m_partition_of;
+    CacheStats m_stats;
+    bool m_admission;
+    // Built by the first lookup once admission is enabled, when the type tells how many entries the budgets hold.
+    std::unique_ptr<FrequencySketch> m_sketch;
+    Entry *m_bypass;
+    std::optional<Climber> m_climber;
+    // Set while get_many() hands out objects, so that the climber does not resize the segments under them.
+    bool m_batching;
+    TimerWheel<Entry> m_timers;
+    Clock::duration m_time_to_live;
+    RemovalListener m_listener;
+    // Indexed by type id, empty for types without a listener of their own.
+    std::vector<RemovalListener> m_typed_listeners;
+
+    static constexpr std::size_t batch_group = 16;
+
+    // Expiry is tracked with millisecond resolution, rounded up so that no entry expires early.
+    static std::uint64_t ticks(const Clock::time_point time) {
+        return static_cast<std::uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(time.time_since_epoch()).count());
+    }
+
+    Entry *&bucket(const std::size_t hash) { return m_buckets[hash & (m_buckets.size() - 1)]; }
+
+    // The type is checked before the object is touched, so only objects of the right type are ever compared.
+    template <class K>
+    Entry *find(const K &key, const std::size_t hash, const std::uint32_t type) {
+        for (Entry *entry = bucket(hash); entry != nullptr; entry = entry->chain) {
+            if (entry->hash == hash && entry->type == type && *entry->value == key) {
+                return entry;
+            }
+        }
+        return nullptr;
+    }
+
+    void unlink_chain(Entry *entry) {
+        Entry **link = &bucket(entry->hash);
+        while (*link != entry) {
+            link = &(*link)->chain;
+        }
+        *link = entry->chain;
+    }
+
+    Partition &partition_of(const std::uint32_t type) {
+        return m_partitions[type < m_partition_of.size() ? m_partition_of[type] : 0];
+    }
+
+    void insert(Entry *entry) {
+        link_chain(entry);
+        push_to_queue(partition_of(entry->type), entry);
+    }
+
+    void link_chain(Entry *entry) {
+        if (size() == m_buckets.size()) {
+            rehash(2 * m_buckets.size());
+        }
+        entry->chain = bucket(entry->hash);
+        bucket(entry->hash) = entry;
+    }
+
+    void rehash(const std::size_t count) {
+        std::vector<Entry *> buckets(count);
+        for (Entry *entry : m_buckets) {
+            while (entry != nullptr) {
+                Entry *next = entry->chain;
+                Entry *&head = buckets[entry->hash & (count - 1)];
+                entry->chain = head;
+                head = entry;
+                entry = next;
+            }
+        }
+        m_buckets.swap(buckets);
+        if (m_sketch && m_sketch->capacity() < count) {
+            // Weighted objects have outgrown the estimate the sketch was sized for; their history starts over.
+            m_sketch = std::make_unique<FrequencySketch>(count);
+        }
+    }
 
+    // Unweighted objects weigh one, so the budgets bound their number; weighted ones start from the bucket count
+    // and are followed by rehash.
     template <class T>
-    void push_to_lfu(KeyProvider *key) {
-        if (lfu.size() == m_max_top_size) {
-            push_to_queue<T>(lfu.back());
-            lfu.pop_back();
+    std::size_t sketch_capacity() const {
+        if constexpr (Weighted<T>) {
+            return std::max(size(), m_buckets.size());
+        } else {
+            std::size_t result = 0;
+            for (const Partition &partition : m_partitions) {
+                result += partition.max_top_size + partition.max_low_size;
+            }
+            return result;
+        }
+    }
+
+    void push_to_lfu(Partition &partition, Entry *entry) {
+        if (entry->weight > partition.max_top_size) {
+            push_to_queue(partition, entry);
+            return;
+        }
+        while (partition.lfu.weight() + entry->weight > partition.max_top_size) {
+            Entry *demoted = partition.lfu.back();
+            partition.lfu.erase(demoted);
+            push_to_queue(partition, demoted);
+            ++m_stats.demotions;
+        }
+        partition.lfu.push_front(entry);
+        entry->segment = Segment::Priority;
+    }
+
+    // The entry just pushed is never evicted here, so a reference to it stays valid until the next lookup.
+    void push_to_queue(Partition &partition, Entry *entry) {
+        partition.queue.push_front(entry);
+        entry->segment = Segment::Regular;
+        while (partition.queue.weight() > partition.max_low_size && partition.queue.back() != entry) {
+            evict(partition);
+        }
+    }
+
+    void make_room(Partition &partition, const std::size_t weight) {
+        while (partition.queue.back() != nullptr && partition.queue.weight() + weight > partition.max_low_size) {
+            evict(partition);
+        }
+    }
+
+    void notify(Entry *entry, const RemovalCause cause) {
+        if (entry->type < m_typed_listeners.size() && m_typed_listeners[entry->type]) {
+            m_typed_listeners[entry->type](*entry->value, cause, entry->dirty);
+        } else if (m_listener) {
+            m_listener(*entry->value, cause, entry->dirty);
+        }
+    }
+
+    void remove(Entry *entry, const RemovalCause cause) {
+        notify(entry, cause);
+        Partition &partition = partition_of(entry->type);
+        (entry->segment == Segment::Priority ? partition.lfu : partition.queue).erase(entry);
+        unlink_chain(entry);
+        m_timers.cancel(entry);
+        entry->drop(m_alloc, entry);
+    }
+
+    void evict(Partition &partition) {
+        remove(partition.queue.back(), RemovalCause::Evicted);
+        ++m_stats.evictions;
+    }
+
+    void resize_segments(const std::size_t top_size) {
+        m_partitions.front().max_top_size = top_size;
+        m_partitions.front().max_low_size = 2 * m_cache_size - top_size;
+        fit(m_partitions.front());
+    }
+
+    void fit(Partition &partition) {
+        while (partition.lfu.weight() > partition.max_top_size) {
+            Entry *demoted = partition.lfu.back();
+            partition.lfu.erase(demoted);
+            partition.queue.push_front(demoted);
+            demoted->segment = Segment::Regular;
+            ++m_stats.demotions;
+        }
+        while (partition.queue.weight() > partition.max_low_size) {
+            evict(partition);
+        }
+    }
+
+    // Counted in entries rather than in the weight budget, so that a cache of heavy objects adapts as often as one
+    // holding as many unweighted ones; it grows with the cache while it fills up.
+    std::size_t climb_sample() const {
+        const Partition &partition = m_partitions.front();
+        return 10 * std::max<std::size_t>(1, partition.lfu.size() + partition.queue.size());
+    }
+
+    void climb(const bool hit) {
+        Climber &climber = *m_climber;
+        climber.hits += hit ? 1 : 0;
+        if (++climber.lookups >= climber.sample && !m_batching) {
+            step_split();
         }
-        lfu.push_front(key);
     }
 
+    void step_split() {
+        Climber &climber = *m_climber;
+        const double rate = static_cast<double>(climber.hits) / climber.lookups;
+        if (climber.previous_rate >= 0) {
+            if (std::abs(rate - climber.previous_rate) >= 0.05) {
+                // The workload changed noticeably: restart the search with a large step.
+                climber.step = std::max<std::size_t>(1, m_cache_size / 8);
+            } else if (rate < climber.previous_rate) {
+                climber.direction = -climber.direction;
+                climber.step = std::max<std::size_t>(1, climber.step / 2);
+            }
+        }
+        climber.previous_rate = rate;
+        climber.sample = climb_sample();
+        climber.lookups = 0;
+        climber.hits = 0;
+        const auto top = static_cast<std::ptrdiff_t>(m_partitions.front().max_top_size) +
+                         climber.direction * static_cast<std::ptrdiff_t>(climber.step);
+        resize_segments(std::clamp<std::ptrdiff_t>(top, 1, 2 * static_cast<std::ptrdiff_t>(m_cache_size) - 1));
+    }
+
+    static void prefetch([[maybe_unused]] const void *address) {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#endif
+    }
+
+    // lookup() without dropping expired entries first.
+    template <class T, class K>
+    T *touch(const K &key, std::size_t hash);
+
+    // Counts an access in the admission sketch, if there is one.
     template <class T>
-    void push_to_queue(KeyProvider *key) {
-        if (queue.size() == m_max_low_size) {
-            m_alloc.template destroy<KeyProvider>(queue.back());
-            queue.pop_back();
+    void record(const std::size_t hash) {
+        if (m_admission) {
+            if (!m_sketch) {
+                m_sketch = std::make_unique<FrequencySketch>(sketch_capacity<T>());
+            }
+            m_sketch->record(hash);
+        }
+    }
+
+    // Moves an entry that was hit to the head of the priority segment.
+    KeyProvider *promote(Entry *entry) {
+        Partition &partition = partition_of(entry->type);
+        if (entry->segment == Segment::Priority) {
+            partition.lfu.erase(entry);
+            ++m_stats.priority_hits;
+        } else {
+            partition.queue.erase(entry);
+            ++m_stats.regular_hits;
+            ++m_stats.promotions;
+        }
+        push_to_lfu(partition, entry);
+        if (m_climber) {
+            climb(true);
+        }
+        return entry->value;
+    }
+
+    // Weight that promoting `entry` moves to the front of the regular segment: the entry itself if it is too heavy
+    // for the priority segment, otherwise the entries it demotes.
+    static std::size_t promotion_spill(const Partition &partition, const Entry *entry) {
+        if (entry->segment == Segment::Priority) {
+            return 0;
+        }
+        if (entry->weight > partition.max_top_size) {
+            return entry->weight;
+        }
+        std::size_t top = partition.lfu.weight();
+        std::size_t spill = 0;
+        for (const Entry *victim = partition.lfu.back(); top + entry->weight > partition.max_top_size;
+             victim = victim->prev) {
+            top -= victim->weight;
+            spill += victim->weight;
+        }
+        return spill;
+    }
+
+    // An object heavier than `room` is handed out uncached, like one the admission filter rejects.
+    template <class T, class K, class... Args>
+    T &add(std::size_t room, const K &key, std::size_t hash, Args &&...args);
+
+    void clear() {
+        drop_bypass();
+        for (Partition &partition : m_partitions) {
+            for (List *segment : {&partition.lfu, &partition.queue}) {
+                while (segment->back() != nullptr) {
+                    Entry *entry = segment->back();
+                    notify(entry, RemovalCause::Cleared);
+                    segment->erase(entry);
+                    m_timers.cancel(entry);
+                    entry->drop(m_alloc, entry);
+                }
+            }
+        }
+        std::fill(m_buckets.begin(), m_buckets.end(), nullptr);
+    }
+
+    static constexpr std::uint32_t snapshot_magic = 0x5552464C;  // "LFRU"
+    static constexpr std::uint32_t snapshot_version = 1;
+
+    template <class V>
+    static void write_raw(std::ostream &out, const V &value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(V));
+    }
+
+    // Readers take the number of bytes left in the file and refuse to read past it, so that no length or count
+    // taken from a corrupt snapshot is trusted.
+    static void read_bytes(std::istream &in, std::uint64_t &left, char *data, const std::uint64_t size) {
+        if (size > left || !in.read(data, static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("truncated cache snapshot");
+        }
+        left -= size;
+    }
+
+    template <class V>
+    static V read_raw(std::istream &in, std::uint64_t &left) {
+        std::array<char, sizeof(V)> bytes;
+        read_bytes(in, left, bytes.data(), bytes.size());
+        return std::bit_cast<V>(bytes);
+    }
+
+    static void write_key(std::ostream &out, const Key &key) {
+        if constexpr (std::is_trivially_copyable_v<Key>) {
+            write_raw(out, key);
+        } else {
+            static_assert(std::is_trivially_copyable_v<std::remove_cvref_t<decltype(*key.data())>>,
+                          "snapshot keys must be trivially copyable or contiguous ranges of such elements");
+            write_raw(out, static_cast<std::uint64_t>(key.size()));
+            out.write(reinterpret_cast<const char *>(key.data()),
+                      static_cast<std::streamsize>(key.size() * sizeof(*key.data())));
+        }
+    }
+
+    // Smallest number of bytes a key takes in a snapshot.
+    static constexpr std::uint64_t min_key_size() {
+        return std::is_trivially_copyable_v<Key> ? sizeof(Key) : sizeof(std::uint64_t);
+    }
+
+    static Key read_key(std::istream &in, std::uint64_t &left) {
+        if constexpr (std::is_trivially_copyable_v<Key>) {
+            return read_raw<Key>(in, left);
+        } else {
+            using Element = std::remove_cvref_t<decltype(*std::declval<const Key &>().data())>;
+            const auto length = read_raw<std::uint64_t>(in, left);
+            if (length > left / sizeof(Element)) {
+                throw std::runtime_error("truncated cache snapshot");
+            }
+            std::vector<Element> elements(length);
+            read_bytes(in, left, reinterpret_cast<char *>(elements.data()), length * sizeof(Element));
+            return Key(elements.data(), elements.size());
+        }
+    }
+
+    // Objects refused by the cache, kept alive until the next miss; linked through `next`.
+    void drop_bypass() {
+        while (m_bypass != nullptr) {
+            Entry *entry = m_bypass;
+            m_bypass = entry->next;
+            entry->drop(m_alloc, entry);
         }
-        queue.push_front(key);
     }
 };
 
-template <class Key, class KeyProvider, class Allocator>
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T, class K>
+inline T *Cache<Key, KeyProvider, Allocator, Hash>::lookup(const K &key, const std::size_t hash) {
+    if (!m_timers.empty()) {
+        expire();
+    }
+    return touch<T>(key, hash);
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T, class K>
+inline T *Cache<Key, KeyProvider, Allocator, Hash>::touch(const K &key, const std::size_t hash) {
+    record<T>(hash);
+    if (Entry *entry = find(key, hash, type_id<T>()); entry != nullptr) {
+        return static_cast<T *>(promote(entry));
+    }
+    return nullptr;
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
 template <class T>
-inline T &Cache<Key, KeyProvider, Allocator>::get(const Key &key) {
-    const auto find_predicate = [key](KeyProvider* value) {
-        return *value == key;
+inline std::size_t Cache<Key, KeyProvider, Allocator, Hash>::get_many(std::span<const Key> keys,
+                                                                  std::span<T *> out) {
+    if (out.size() < keys.size()) {
+        throw std::invalid_argument("get_many needs an output slot for every key");
+    }
+    std::array<std::size_t, batch_group> hashes;
+    drop_bypass();
+    if (!m_timers.empty()) {
+        expire();
+    }
+    if (m_climber && m_climber->lookups >= m_climber->sample) {
+        step_split();
+    }
+    struct Batching {
+        bool &flag;
+        ~Batching() { flag = false; }
+    } batching{m_batching = true};
+    // Weight the batch may still move to the front of each segment without pushing out an object it handed out.
+    const std::uint32_t type = type_id<T>();
+    const Partition &partition = partition_of(type);
+    std::size_t top_room = partition.max_top_size;
+    std::size_t low_room = partition.max_low_size;
+    std::size_t served = 0;
+    for (std::size_t begin = 0; begin < keys.size(); begin += batch_group) {
+        const std::size_t count = std::min(batch_group, keys.size() - begin);
+        for (std::size_t i = 0; i < count; ++i) {
+            hashes[i] = Hash{}(keys[begin + i]);
+            prefetch(&bucket(hashes[i]));
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            prefetch(bucket(hashes[i]));
+        }
+        for (std::size_t i = 0; i < count; ++i, ++served) {
+            const Key &key = keys[begin + i];
+            if (Entry *entry = find(key, hashes[i], type); entry != nullptr) {
+                const std::size_t top_push = entry->weight <= partition.max_top_size ? entry->weight : 0;
+                const std::size_t low_push = promotion_spill(partition, entry);
+                if (served > 0 && (top_push > top_room || low_push > low_room)) {
+                    return served;
+                }
+                top_room -= std::min(top_room, top_push);
+                low_room -= std::min(low_room, low_push);
+                record<T>(hashes[i]);
+                out[begin + i] = static_cast<T *>(promote(entry));
+                continue;
+            }
+            if (served > 0 && low_room == 0) {
+                return served;
+            }
+            record<T>(hashes[i]);
+            T &object = add<T>(low_room, key, hashes[i], key);
+            out[begin + i] = &object;
+            std::size_t weight = 1;
+            if constexpr (Weighted<T>) {
+                weight = object.weight();
+            }
+            if (weight > low_room) {
+                return served + 1;
+            }
+            low_room -= weight;
+        }
+    }
+    return served;
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T, class K, class... Args>
+inline T &Cache<Key, KeyProvider, Allocator, Hash>::add(const std::size_t room, const K &key, const std::size_t hash,
+                                                        Args &&...args) {
+    if (Entry *entry = find(key, hash, type_id<T>()); entry != nullptr) {
+        return *static_cast<T *>(entry->value);
+    }
+    ++m_stats.misses;
+    if (m_climber) {
+        climb(false);
+    }
+    // The weight of an object is only known once it exists; unweighted ones make room before allocating, so a pool
+    // sized for exactly the cache capacity never overflows.
+    Node<T> *node = nullptr;
+    std::size_t weight = 1;
+    if constexpr (Weighted<T>) {
+        node = m_alloc.template create<Node<T>>(std::forward<Args>(args)...);
+        weight = node->weight;
+    }
+    Partition &partition = partition_of(type_id<T>());
+    const List &queue = partition.queue;
+    const bool full = queue.back() != nullptr && queue.weight() + weight > partition.max_low_size;
+    if (weight > std::min(room, partition.max_low_size) ||
+        (full && m_sketch && !m_sketch->admit(hash, queue.back()->hash))) {
+        ++m_stats.rejections;
+        if (node == nullptr) {
+            node = m_alloc.template create<Node<T>>(std::forward<Args>(args)...);
+        }
+        node->next = m_bypass;
+        m_bypass = node;
+        return node->object;
+    }
+    make_room(partition, weight);
+    if (node == nullptr) {
+        node = m_alloc.template create<Node<T>>(std::forward<Args>(args)...);
+    }
+    node->hash = hash;
+    insert(node);
+    if (m_time_to_live > Clock::duration::zero()) {
+        node->expires = ticks(Clock::now() + m_time_to_live);
+        m_timers.schedule(node);
+    }
+    return node->object;
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T, class KeyOf>
+inline void Cache<Key, KeyProvider, Allocator, Hash>::save(const std::filesystem::path &path, KeyOf &&key_of,
+                                                           const bool with_values) const {
+    if constexpr (!std::is_trivially_copyable_v<T>) {
+        if (with_values) {
+            throw std::invalid_argument("only trivially copyable objects can be saved with a snapshot");
+        }
+    }
+    // Written next to the target and renamed over it once complete, so that a failed save never destroys the
+    // previous snapshot.
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    write_raw(out, snapshot_magic);
+    write_raw(out, snapshot_version);
+    write_raw(out, static_cast<std::uint64_t>(with_values ? sizeof(T) : 0));
+    const std::uint32_t type = type_id<T>();
+    const Partition &partition = m_partitions[type < m_partition_of.size() ? m_partition_of[type] : 0];
+    for (const List *segment : {&partition.lfu, &partition.queue}) {
+        std::uint64_t count = 0;
+        for (const Entry *entry = segment->front(); entry != nullptr; entry = entry->next) {
+            count += entry->type == type ? 1 : 0;
+        }
+        write_raw(out, count);
+        for (const Entry *entry = segment->front(); entry != nullptr; entry = entry->next) {
+            if (entry->type != type) {
+                continue;
+            }
+            const T &object = *static_cast<const T *>(entry->value);
+            write_key(out, std::invoke(key_of, object));
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                if (with_values) {
+                    write_raw(out, object);
+                }
+            }
+        }
+    }
+    out.close();
+    if (!out) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        throw std::runtime_error("cannot write cache snapshot " + path.string());
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T>
+inline void Cache<Key, KeyProvider, Allocator, Hash>::load(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("cannot open cache snapshot " + path.string());
+    }
+    auto left = static_cast<std::uint64_t>(in.tellg());
+    in.seekg(0);
+    if (read_raw<std::uint32_t>(in, left) != snapshot_magic ||
+        read_raw<std::uint32_t>(in, left) != snapshot_version) {
+        throw std::runtime_error("not a cache snapshot: " + path.string());
+    }
+    const auto value_size = read_raw<std::uint64_t>(in, left);
+    if (value_size != 0 && (!std::is_trivially_copyable_v<T> || value_size != sizeof(T))) {
+        throw std::runtime_error("cache snapshot holds objects of another type: " + path.string());
+    }
+    if (value_size == 0 && !std::is_constructible_v<T, const Key &>) {
+        throw std::runtime_error("cache snapshot holds no objects and they cannot be built from keys");
+    }
+    // The whole file is read and checked before the cache is touched, so a bad snapshot leaves it as it was.
+    std::array<std::vector<Key>, 2> keys;
+    std::array<std::vector<char>, 2> values;
+    for (std::size_t s = 0; s < keys.size(); ++s) {
+        const auto count = read_raw<std::uint64_t>(in, left);
+        if (count > left / (min_key_size() + value_size)) {
+            throw std::runtime_error("corrupt cache snapshot " + path.string());
+        }
+        keys[s].reserve(count);
+        values[s].resize(count * value_size);
+        for (std::uint64_t i = 0; i < count; ++i) {
+            keys[s].push_back(read_key(in, left));
+            read_bytes(in, left, values[s].data() + i * value_size, value_size);
+        }
+    }
+    if (left != 0) {
+        throw std::runtime_error("corrupt cache snapshot " + path.string());
+    }
+    clear();
+    Partition &partition = partition_of(type_id<T>());
+    for (const Segment segment : {Segment::Priority, Segment::Regular}) {
+        const std::size_t s = segment == Segment::Priority ? 0 : 1;
+        List &list = segment == Segment::Priority ? partition.lfu : partition.queue;
+        const std::size_t capacity = segment == Segment::Priority ? partition.max_top_size : partition.max_low_size;
+        // Sized once up front instead of doubling while the entries arrive.
+        if (size() + keys[s].size() >= m_buckets.size()) {
+            rehash(std::bit_ceil(size() + keys[s].size() + 1));
+        }
+        for (std::size_t i = 0; i < keys[s].size(); ++i) {
+            const Key &key = keys[s][i];
+            // Unweighted objects are known to fit before they are built.
+            const bool fits = Weighted<T> || list.weight() < capacity;
+            Node<T> *node = nullptr;
+            if (value_size != 0) {
+                if constexpr (std::is_trivially_copyable_v<T>) {
+                    std::array<char, sizeof(T)> bytes;
+                    std::copy_n(values[s].data() + i * value_size, bytes.size(), bytes.data());
+                    node = fits ? m_alloc.template create<Node<T>>(std::bit_cast<T>(bytes)) : nullptr;
+                }
+            } else if constexpr (std::is_constructible_v<T, const Key &>) {
+                node = fits ? m_alloc.template create<Node<T>>(key) : nullptr;
+            }
+            if (node == nullptr) {
+                continue;
+            }
+            node->hash = Hash{}(key);
+            if (list.weight() + node->weight > capacity || find(key, node->hash, node->type) != nullptr) {
+                node->drop(m_alloc, node);
+                continue;
+            }
+            link_chain(node);
+            list.push_back(node);
+            node->segment = segment;
+            if (m_time_to_live > Clock::duration::zero()) {
+                node->expires = ticks(Clock::now() + m_time_to_live);
+                m_timers.schedule(node);
+            }
+        }
+    }
+}
+
+template <class Key, class KeyProvider, class Allocator, class Hash>
+inline std::ostream &Cache<Key, KeyProvider, Allocator, Hash>::print(std::ostream &strm) const {
+    const auto print_segment = [&strm](const char *name, const List &segment) {
+        strm << name << ":";
+        if (segment.size() == 0) {
+            strm << " <empty>";
+        }
+        for (const Entry *entry = segment.front(); entry != nullptr; entry = entry->next) {
+            strm << " " << *entry->value;
+        }
+        strm << "\n";
     };
-    auto it = std::find_if(lfu.begin(), lfu.end(), find_predicate);
-    if (it != lfu.end()) {
-        lfu.splice(lfu.begin(), lfu, it);
-        return *static_cast<T *>(lfu.front());
-    }
-    it = std::find_if(queue.begin(), queue.end(), find_predicate);
-    if (it != queue.end()) {
-        auto insert = *it;
-        queue.erase(it);
-        push_to_lfu<T>(insert);
-        return *static_cast<T *>(lfu.front());
-    }
-    push_to_queue<T>(static_cast<T *>(m_alloc.template create<T>(T(key))));
-    return *static_cast<T *>(queue.front());
+    print_segment("Priority", m_partitions.front().lfu);
+    print_segment("Regular", m_partitions.front().queue);
+    for (std::size_t i = 1; i < m_partitions.size(); ++i) {
+        strm << "Quota " << i << ":\n";
+        print_segment("  Priority", m_partitions[i].lfu);
+        print_segment("  Regular", m_partitions[i].queue);
+    }
+    return strm;
 }
 
-template <class Key, class KeyProvider, class Allocator>
-inline std::ostream &Cache<Key, KeyProvider, Allocator>::print(std::ostream &strm) const {
-    return strm << "Priority: <empty>"
-                << "\nRegular: <empty>"
-                << "\n";
+template <class Key, class KeyProvider, class Allocator, class Hash>
+template <class T>
+inline void Cache<Key, KeyProvider, Allocator, Hash>::set_quota(const std::size_t cache_size) {
+    const std::uint32_t type = type_id<T>();
+    if (type >= m_partition_of.size()) {
+        m_partition_of.resize(type + 1, 0);
+    }
+    if (m_partition_of[type] == 0) {
+        m_partition_of[type] = static_cast<std::uint16_t>(m_partitions.size());
+        m_partitions.push_back(Partition{List(), List(), cache_size, cache_size});
+        Partition &shared = m_partitions.front();
+        Partition &own = m_partitions.back();
+        for (auto [from, to] : {std::pair{&shared.lfu, &own.lfu}, std::pair{&shared.queue, &own.queue}}) {
+            for (Entry *entry = from->back(); entry != nullptr;) {
+                Entry *newer = entry->prev;
+                if (entry->type == type) {
+                    from->erase(entry);
+                    to->push_front(entry);
+                }
+                entry = newer;
+            }
+        }
+    }
+    Partition &own = m_partitions[m_partition_of[type]];
+    own.max_top_size = cache_size;
+    own.max_low_size = cache_size;
+    fit(own);
 }
 
 #endif  // ACP_CACHE_HPP
@@ -0,0 +1,42 @@
+#ifndef ACP_FREQUENCY_SKETCH_HPP
+#define ACP_FREQUENCY_SKETCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// TinyLFU popularity estimate: a doorkeeper bloom filter absorbs the first occurrence of a key, repeated ones go to
+// a count-min sketch of 4-bit counters. Every `sample_size` records all counters are halved and the doorkeeper is
+// cleared, so the estimate follows recent history.
+class FrequencySketch {
+private:
+    static constexpr std::size_t depth = 4;
+    static constexpr std::uint32_t max_count = 15;
+
+    std::vector<std::uint64_t> _table;
+    std::vector<std::uint64_t> _doorkeeper;
+    std::size_t _sample_size;
+    std::size_t _additions;
+
+    static std::uint64_t rehash(std::size_t const hash, std::size_t const row);
+
+    bool doorkeeper_contains(std::size_t const hash) const;
+    bool doorkeeper_put(std::size_t const hash);
+    void age();
+
+public:
+    explicit FrequencySketch(std::size_t const capacity);
+
+    // The requested capacity rounded up to a power of two.
+    std::size_t capacity() const { return _table.size() * 4; }
+
+    void record(std::size_t const hash);
+
+    std::uint32_t estimate(std::size_t const hash) const;
+
+    bool admit(std::size_t const candidate, std::size_t const victim) const {
+        return estimate(candidate) > estimate(victim);
+    }
+};
+
+#endif  // ACP_FREQUENCY_SKETCH_HPP
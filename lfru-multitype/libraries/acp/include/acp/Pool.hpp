@@ -1,28 +1,234 @@
 #ifndef ACP_POOL_HPP
 #define ACP_POOL_HPP
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <new>
-#include <unordered_map>
 #include <vector>
 
+// Build with ACP_POOL_STATS to count allocations per size class, with ACP_POOL_DEBUG to additionally report where
+// objects still live at destruction were allocated (link with -rdynamic to get symbol names). Both change the class
+// layout, so every translation unit has to agree on them; without them the pool carries no trace of either.
+#if defined(ACP_POOL_DEBUG) && !defined(ACP_POOL_STATS)
+#define ACP_POOL_STATS
+#endif
+
+#ifdef ACP_POOL_DEBUG
+#include <unordered_map>
+#endif
+
 class PoolAllocator {
+public:
+    // Slots held in thread caches count as used: the depot cannot hand them out.
+    struct Occupancy {
+        std::size_t size;
+        std::size_t slabs;
+        std::size_t used;
+        std::size_t capacity;
+    };
+
+    // Every slab starts with a header of this size, the rest is split into slots.
+    static constexpr std::size_t header_size = 64;
+
+#ifdef ACP_POOL_STATS
+    // Unlike occupancy, `live` counts only objects handed out to callers.
+    struct Profile {
+        std::size_t size;
+        std::size_t live;
+        std::size_t peak;
+        std::size_t allocations;
+        std::size_t frees;
+        std::size_t failures;
+        std::size_t slabs;
+    };
+#endif
+
 private:
-    using pos_type = std::pair<std::size_t, std::size_t>;
-    inline static constexpr pos_type invalid_pos{static_cast<std::size_t>(-1), static_cast<std::size_t>(-1)};
-    std::vector<std::vector<std::byte>> _data;
-    std::vector<std::vector<bool>> _used;
-    std::unordered_map<std::size_t, std::size_t> _block_pos;
+    static constexpr std::size_t magazine_size = 32;
+    static constexpr std::size_t free_batch = 64;
+
+    // Header at the start of every slab, so masking a slot address finds it without any lookup. Released slots are
+    // threaded into an intrusive free list; slots past `carved` have never been handed out. Objects larger than a
+    // slab get a header of their own with `size_class == large_class` and the length of their mapping in `carved`.
+    struct alignas(header_size) Slab {
+        void* free;
+        std::size_t used;
+        std::size_t carved;
+        std::size_t size_class;
+        Slab* prev;
+        Slab* next;
+        std::chrono::steady_clock::time_point empty_since;
+        bool purged;
+        bool hugetlb;
+    };
+
+    static constexpr std::size_t large_class = static_cast<std::size_t>(-1);
+
+    // Every slab is on exactly one of the lists. Empty ones beyond the high-water mark are unmapped, the retained
+    // ones have their pages dropped once they stayed empty for the decay time.
+    struct SizeClass {
+        std::size_t size;
+        std::size_t slot_size;
+        std::size_t capacity;
+        Slab* partial;
+        Slab* full;
+        Slab* empty;
+        std::size_t empty_count;
+    };
+
+    struct Magazine {
+        std::size_t count;
+        std::array<void*, magazine_size> slots;
+    };
+
+    // Per-thread front end: allocations pop from the magazine of their class and frees push back onto it without
+    // locking; frees that find their magazine full are queued and handed to the depot in one locked batch. Caches of
+    // exited threads are reclaimed by the depot.
+    struct ThreadCache {
+        std::vector<Magazine> magazines;
+        std::size_t pending = 0;
+        std::array<void*, free_batch> freed;
+        std::atomic<bool> detached = false;
+    };
+
+    std::size_t _slab_align;
+    std::size_t _max_empty_slabs;
+    std::chrono::steady_clock::duration _decay_time;
+    std::chrono::steady_clock::time_point _next_purge;
+    bool _huge_pages;
+    std::vector<SizeClass> _classes;
+    std::vector<std::uint16_t> _class_index;
+    std::uint64_t const _id;
+    std::mutex _depot_lock;
+    std::vector<std::shared_ptr<ThreadCache>> _thread_caches;
+    std::atomic<void*> _remote_free;
+
+    // Treiber stack of free slots per size class in shared mode. The head packs the top slot's address into the low
+    // bits and a counter bumped by every push and pop into the high ones, so a pop that read a stale top fails its
+    // exchange instead of installing a stale successor. The counter has `tag_bits` bits and wraps: a pop stalled
+    // between reading the head and its exchange while a multiple of 2^tag_bits other pushes and pops complete, with
+    // the same slot on top again, still succeeds with a stale successor. A pointer with a full 64-bit counter would
+    // need a 16-byte exchange, which std::atomic does not provide lock-free without libatomic.
+    static constexpr unsigned tag_bits = sizeof(void*) < 8 ? 34 : 19;
+
+    struct alignas(64) SharedStack {
+        std::atomic<std::uint64_t> head{0};
+    };
+
+    std::unique_ptr<SharedStack[]> _shared;
+
+    void push_shared(std::size_t const size_class, void* first, void* last);
+    void* pop_shared(std::size_t const size_class);
+
+#ifdef ACP_POOL_STATS
+    struct alignas(64) Counters {
+        std::atomic<std::size_t> live{0};
+        std::atomic<std::size_t> peak{0};
+        std::atomic<std::size_t> allocations{0};
+        std::atomic<std::size_t> frees{0};
+        std::atomic<std::size_t> failures{0};
+        std::atomic<std::size_t> slabs{0};
+    };
+
+    // One past the size classes for large objects.
+    std::unique_ptr<Counters[]> _counters;
 
-    pos_type find_free(std::size_t const size);
+    void count_allocation(std::size_t const size_class);
+#endif
+
+#ifdef ACP_POOL_DEBUG
+    static constexpr std::size_t call_depth = 8;
+
+    struct CallSite {
+        std::size_t depth;
+        std::array<void*, call_depth> frames;
+    };
+
+    std::mutex _sites_lock;
+    std::unordered_map<void const*, CallSite> _sites;
+
+    void remember(void const* ptr);
+    void forget(void const* ptr);
+    void report_leaks();
+#endif
+
+    std::size_t find_class(std::size_t const size) const;
+    Slab& slab_of(void const* ptr) const;
+    ThreadCache& thread_cache();
+
+    void refill(Magazine& magazine, std::size_t const size_class);
+    void flush(ThreadCache& cache);
+    void drain_remote();
+    void reclaim_detached();
+
+    void* allocate_in(std::size_t const size_class, std::size_t const size);
+    void* take(std::size_t const size_class);
+    void give(void* ptr, ThreadCache* cache);
+
+    Slab& new_slab(std::size_t const size_class);
+    void release_slab(Slab& slab);
+    void purge_slab(Slab& slab);
+    void purge_empty();
+    void free_slabs(Slab* head);
+
+    static void link(Slab*& head, Slab& slab);
+    static void unlink(Slab*& head, Slab& slab);
 
 public:
-    PoolAllocator(std::size_t const block_size, std::initializer_list<std::size_t> list);
+    PoolAllocator(std::size_t const block_size, std::initializer_list<std::size_t> list,
+                  std::size_t const max_empty_slabs = 1);
+
+    // Requests are rounded up to the nearest of `sizes`; anything larger than the biggest of them goes to a
+    // power-of-two class, down to one slot per slab, and only objects too large for a slab are mapped one by one.
+    // Slabs are mapped straight from the system and span `block_size` rounded up to a power of two and to at least
+    // a page, header included.
+    PoolAllocator(std::size_t const block_size, std::vector<std::size_t> sizes, std::size_t const max_empty_slabs = 1);
 
+    PoolAllocator(PoolAllocator const&) = delete;
+    PoolAllocator& operator=(PoolAllocator const&) = delete;
+
+    ~PoolAllocator();
+
+    // Both are safe to call concurrently; memory may be freed on a different thread than it was allocated on.
     void* allocate(std::size_t const size);
 
     void deallocate(void const* ptr);
+
+    std::vector<Occupancy> occupancy();
+
+    // Slabs mapped afterwards are backed by huge pages: explicit ones when the slab size allows and the system has
+    // them reserved, transparent ones otherwise.
+    void enable_huge_pages(bool const enable);
+
+    // Lets threads exchange freed slots through a lock-free stack per size class rather than through the depot, so
+    // neither allocation nor deallocation locks once every class has been carved. Slots freed in this mode never
+    // return to their slabs, which are thus kept for the lifetime of the pool. Has to be called before the first
+    // allocation and cannot be undone.
+    void enable_shared_mode();
+
+    // How long a retained empty slab keeps its pages before they are given back; its address range stays reserved,
+    // unless the slab sits on explicit huge pages, which can only be given back by unmapping it.
+    void set_decay_time(std::chrono::steady_clock::duration const decay_time);
+
+    // jemalloc-like table: multiples of the pointer size at first, then `steps` evenly spaced classes per power of
+    // two, which bounds internal fragmentation by 1 / steps.
+    static std::vector<std::size_t> geometric_classes(std::size_t const max_size, std::size_t const steps = 4);
+
+#ifdef ACP_POOL_STATS
+    // The last entry, with size 0, covers objects too large for any class.
+    std::vector<Profile> profile() const;
+#endif
+
+protected:
+    // For front ends that resolve the size class on their own: `size_class` indexes the sorted and deduplicated
+    // size list.
+    void* allocate_class(std::size_t const size_class, std::size_t const size);
 };
 
 #endif  // ACP_POOL_HPP
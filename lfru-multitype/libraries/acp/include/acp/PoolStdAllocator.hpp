@@ -0,0 +1,53 @@
+#ifndef ACP_POOL_STD_ALLOCATOR_HPP
+#define ACP_POOL_STD_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#include "acp/Pool.hpp"
+
+// Standard allocator over a PoolAllocator: single objects (list, map and hash table nodes) come from the slab for
+// their size, arrays (hash table buckets, vector storage) and over-aligned types go to the global operator new.
+template <class T>
+class PoolStdAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit PoolStdAllocator(PoolAllocator &pool) noexcept : m_pool(&pool) {}
+
+    template <class U>
+    PoolStdAllocator(const PoolStdAllocator<U> &other) noexcept : m_pool(&other.pool()) {}
+
+    PoolAllocator &pool() const noexcept { return *m_pool; }
+
+    T *allocate(const std::size_t n) {
+        if (from_pool(n)) {
+            return static_cast<T *>(m_pool->allocate(sizeof(T)));
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+
+    void deallocate(T *ptr, const std::size_t n) {
+        if (from_pool(n)) {
+            m_pool->deallocate(ptr);
+        } else {
+            ::operator delete(ptr, std::align_val_t{alignof(T)});
+        }
+    }
+
+    template <class U>
+    friend bool operator==(const PoolStdAllocator &lhs, const PoolStdAllocator<U> &rhs) noexcept {
+        return &lhs.pool() == &rhs.pool();
+    }
+
+private:
+    PoolAllocator *m_pool;
+
+    static constexpr bool from_pool(const std::size_t n) { return n == 1 && alignof(T) <= alignof(void *); }
+};
+
+#endif  // ACP_POOL_STD_ALLOCATOR_HPP
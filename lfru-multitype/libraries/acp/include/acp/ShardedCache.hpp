@@ -0,0 +1,273 @@
+#ifndef ACP_SHARDED_CACHE_HPP
+#define ACP_SHARDED_CACHE_HPP
+
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "acp/Cache.hpp"
+
+// Thread-safe front end: keys are hashed to independent LFRU shards, each with its own lock and allocator.
+template <class Key, class KeyProvider, class Allocator, class Hash = std::hash<Key>>
+class ShardedCache {
+    using Shard = Cache<Key, KeyProvider, Allocator, Hash>;
+
+    struct alignas(64) Slot {
+        template <class... AllocArgs>
+        Slot(const std::size_t cache_size, const AllocArgs &...alloc_args)
+            : lock(), cache(cache_size, alloc_args...), loading() {}
+
+        mutable std::mutex lock;
+        Shard cache;
+        // Keys whose loader is running on some thread; other threads missing on them wait for it instead.
+        std::unordered_map<Key, std::shared_future<void>, Hash> loading;
+    };
+
+public:
+    // `cache_size` is the total capacity of each segment, split evenly between the shards; the shard count is
+    // rounded up to a power of two.
+    template <class... AllocArgs>
+    ShardedCache(const std::size_t shard_count, const std::size_t cache_size, const AllocArgs &...alloc_args)
+        : m_shift(std::numeric_limits<std::size_t>::digits - std::bit_width(std::bit_ceil(shard_count) - 1))
+        , m_shards() {
+        const std::size_t count = std::bit_ceil(shard_count);
+        m_shards.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            m_shards.push_back(std::make_unique<Slot>((cache_size + count - 1) / count, alloc_args...));
+        }
+    }
+
+    template <class T>
+    static constexpr std::size_t entry_size() {
+        return Shard::template entry_size<T>();
+    }
+
+    std::size_t shard_count() const { return m_shards.size(); }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            result += shard->cache.size();
+        }
+        return result;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    CacheStats stats() const {
+        CacheStats result;
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            result += shard->cache.stats();
+        }
+        return result;
+    }
+
+    void enable_admission_filter(const bool enable = true) {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.enable_admission_filter(enable);
+        }
+    }
+
+    void set_time_to_live(const typename Shard::Clock::duration ttl) {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.set_time_to_live(ttl);
+        }
+    }
+
+    std::size_t expire(const typename Shard::Clock::time_point now = Shard::Clock::now()) {
+        std::size_t result = 0;
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            result += shard->cache.expire(now);
+        }
+        return result;
+    }
+
+    // The listener is shared by all shards and runs under the lock of the shard the object left.
+    void set_removal_listener(const typename Shard::RemovalListener &listener) {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.set_removal_listener(listener);
+        }
+    }
+
+    template <class T>
+    void set_removal_listener(const std::function<void(T &, RemovalCause, bool)> &listener) {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.template set_removal_listener<T>(listener);
+        }
+    }
+
+    // Like `cache_size`, the quota is split evenly between the shards.
+    template <class T>
+    void set_quota(const std::size_t cache_size) {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.template set_quota<T>((cache_size + m_shards.size() - 1) / m_shards.size());
+        }
+    }
+
+    template <class T>
+    bool mark_dirty(const Key &key) {
+        const std::size_t hash = Hash{}(key);
+        Slot &shard = *m_shards[shard_of(hash)];
+        std::lock_guard lock(shard.lock);
+        return shard.cache.template mark_dirty<T>(key);
+    }
+
+    void reset_stats() {
+        for (const auto &shard : m_shards) {
+            std::lock_guard lock(shard->lock);
+            shard->cache.reset_stats();
+        }
+    }
+
+    // The entry may be evicted by another thread as soon as the shard is unlocked, so it is only exposed to `f`,
+    // which runs under the shard lock.
+    template <class T, class F>
+    decltype(auto) get(const Key &key, F &&f) {
+        return get_hashed<T>(key, std::forward<F>(f));
+    }
+
+    template <class T, class K, class F>
+        requires LookupKey<K, Key, Hash>
+    decltype(auto) get(const K &key, F &&f) {
+        return get_hashed<T>(key, std::forward<F>(f));
+    }
+
+    template <class T>
+    T get(const Key &key) {
+        return get<T>(key, [](T &value) { return value; });
+    }
+
+    template <class T, class K>
+        requires LookupKey<K, Key, Hash>
+    T get(const K &key) {
+        return get<T>(key, [](T &value) { return value; });
+    }
+
+    // Batched get: keys are grouped by shard so that each shard is locked once per batch; `f(i, value)` is called
+    // for every `keys[i]` under the lock of its shard.
+    template <class T, class F>
+    void get_many(std::span<const Key> keys, F &&f) {
+        std::vector<std::size_t> hashes(keys.size());
+        std::vector<std::size_t> order(keys.size());
+        std::vector<std::size_t> starts(m_shards.size() + 1);
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            hashes[i] = Hash{}(keys[i]);
+            ++starts[shard_of(hashes[i]) + 1];
+        }
+        for (std::size_t i = 0; i < m_shards.size(); ++i) {
+            starts[i + 1] += starts[i];
+        }
+        std::vector<std::size_t> fill(starts.begin(), starts.end() - 1);
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            order[fill[shard_of(hashes[i])]++] = i;
+        }
+        for (std::size_t s = 0; s < m_shards.size(); ++s) {
+            if (starts[s] == starts[s + 1]) {
+                continue;
+            }
+            std::lock_guard lock(m_shards[s]->lock);
+            for (std::size_t k = starts[s]; k < starts[s + 1]; ++k) {
+                const std::size_t i = order[k];
+                std::invoke(f, i, m_shards[s]->cache.template get<T>(keys[i], hashes[i]));
+            }
+        }
+    }
+
+    // Read-through lookup with single-flight misses: the first thread to miss a key runs `loader(key)` outside the
+    // shard lock, concurrent misses on the same key wait for it and then read the cached result.
+    template <class T, class Loader, class F>
+    decltype(auto) get_or_load(const Key &key, Loader &&loader, F &&f) {
+        const std::size_t hash = Hash{}(key);
+        Slot &shard = *m_shards[shard_of(hash)];
+        std::unique_lock lock(shard.lock);
+        for (;;) {
+            if (T *value = shard.cache.template lookup<T>(key, hash)) {
+                return std::invoke(std::forward<F>(f), *value);
+            }
+            auto flight = shard.loading.find(key);
+            if (flight == shard.loading.end()) {
+                break;
+            }
+            const std::shared_future<void> done = flight->second;
+            lock.unlock();
+            done.wait();
+            lock.lock();
+        }
+        // Other keys may be inserted while the loader runs, so the flight is found again by key afterwards.
+        std::promise<void> promise;
+        shard.loading.emplace(key, promise.get_future().share());
+        lock.unlock();
+        std::optional<T> loaded;
+        try {
+            loaded.emplace(std::invoke(std::forward<Loader>(loader), key));
+        } catch (...) {
+            // Waiters retry and one of them becomes the next loader.
+            lock.lock();
+            shard.loading.erase(key);
+            promise.set_value();
+            throw;
+        }
+        lock.lock();
+        shard.loading.erase(key);
+        promise.set_value();
+        return std::invoke(std::forward<F>(f), shard.cache.template emplace<T>(key, hash, std::move(*loaded)));
+    }
+
+    // Runs get_or_load on another thread and yields a copy of the object, so a caller can overlap several loads.
+    template <class T, class Loader>
+    std::future<T> get_or_load_async(const Key &key, Loader loader) {
+        return std::async(std::launch::async, [this, key, loader = std::move(loader)]() mutable {
+            return get_or_load<T>(key, loader, [](T &value) { return value; });
+        });
+    }
+
+    std::ostream &print(std::ostream &strm) const {
+        for (std::size_t i = 0; i < m_shards.size(); ++i) {
+            std::lock_guard lock(m_shards[i]->lock);
+            strm << "Shard " << i << ":\n" << m_shards[i]->cache;
+        }
+        return strm;
+    }
+
+    friend std::ostream &operator<<(std::ostream &strm, const ShardedCache &cache) { return cache.print(strm); }
+
+private:
+    const std::size_t m_shift;
+    std::vector<std::unique_ptr<Slot>> m_shards;
+
+    template <class T, class K, class F>
+    decltype(auto) get_hashed(const K &key, F &&f) {
+        const std::size_t hash = Hash{}(key);
+        Slot &shard = *m_shards[shard_of(hash)];
+        std::lock_guard lock(shard.lock);
+        return std::invoke(std::forward<F>(f), shard.cache.template get<T>(key, hash));
+    }
+
+    // Fibonacci hashing on the top bits, so shard choice stays independent of the bucket bits used inside a shard.
+    std::size_t shard_of(const std::size_t hash) const {
+        if (m_shards.size() == 1) {
+            return 0;
+        }
+        return (hash * static_cast<std::size_t>(0x9E3779B97F4A7C15ULL)) >> m_shift;
+    }
+};
+
+#endif  // ACP_SHARDED_CACHE_HPP
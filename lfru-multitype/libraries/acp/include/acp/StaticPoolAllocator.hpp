@@ -0,0 +1,60 @@
+#ifndef ACP_STATIC_POOL_ALLOCATOR_HPP
+#define ACP_STATIC_POOL_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include "acp/Pool.hpp"
+
+// Pool with its block size and size classes fixed at compile time: create<T> picks the class for sizeof(T) during
+// compilation, so allocating skips the size lookup altogether, and a type no class fits is a compile error.
+template <std::size_t BlockSize, std::size_t... Sizes>
+class StaticPoolAllocator: private PoolAllocator {
+    static constexpr std::array<std::size_t, sizeof...(Sizes)> sizes{Sizes...};
+
+    static_assert(sizeof...(Sizes) > 0, "a pool needs at least one size class");
+    static_assert(std::is_sorted(sizes.begin(), sizes.end(), std::less_equal<>{}) && sizes.front() > 0,
+                  "size classes must be positive and strictly increasing");
+    static_assert(std::bit_ceil(std::max(BlockSize, 2 * header_size)) - header_size >=
+                      (std::max(sizes.back(), sizeof(void *)) + alignof(void *) - 1) / alignof(void *) *
+                          alignof(void *),
+                  "every size class must fit into a block");
+
+    static constexpr std::size_t class_of(const std::size_t size) {
+        return static_cast<std::size_t>(std::lower_bound(sizes.begin(), sizes.end(), size) - sizes.begin());
+    }
+
+public:
+    explicit StaticPoolAllocator(const std::size_t max_empty_slabs = 1)
+        : PoolAllocator(BlockSize, {Sizes...}, max_empty_slabs) {}
+
+    using PoolAllocator::enable_huge_pages;
+    using PoolAllocator::enable_shared_mode;
+    using PoolAllocator::occupancy;
+#ifdef ACP_POOL_STATS
+    using PoolAllocator::profile;
+#endif
+    using PoolAllocator::set_decay_time;
+
+    template <class T, class... Args>
+    T *create(Args &&...args) {
+        constexpr std::size_t size_class = class_of(sizeof(T));
+        static_assert(size_class < sizes.size(), "no size class of the pool fits this type");
+        static_assert(alignof(T) <= alignof(void *), "pool slots are only aligned for pointers");
+        auto *ptr = allocate_class(size_class, sizeof(T));
+        return new (ptr) T(std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    void destroy(void *ptr) {
+        static_cast<T *>(ptr)->~T();
+        deallocate(ptr);
+    }
+};
+
+#endif  // ACP_STATIC_POOL_ALLOCATOR_HPP
@@ -0,0 +1,122 @@
+#ifndef ACP_TIMER_WHEEL_HPP
+#define ACP_TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Hierarchical timing wheel over intrusive nodes exposing `expires` (in ticks), `timer_prev`, `timer_next` and
+// `timer_slot` (0 while not scheduled). Level k has 64 slots of 64^k ticks each; a timer lives on the level of the
+// highest 6-bit digit in which its expiry differs from the current time and is moved down when that slot comes due,
+// so scheduling and cancelling are O(1) and advancing costs O(1) per timer per level it passes through.
+template <class Node>
+class TimerWheel {
+    static constexpr unsigned bits = 6;
+    static constexpr unsigned slots = 1U << bits;
+    static constexpr unsigned levels = (std::numeric_limits<std::uint64_t>::digits + bits - 1) / bits;
+
+public:
+    bool empty() const { return m_count == 0; }
+
+    std::size_t size() const { return m_count; }
+
+    std::uint64_t now() const { return m_now; }
+
+    // A node that is already due is placed in the next tick.
+    void schedule(Node *node) {
+        const std::uint64_t expires = std::max(node->expires, m_now + 1);
+        const auto level = static_cast<unsigned>(std::bit_width(expires ^ m_now) - 1) / bits;
+        const auto index = level * slots + digit(expires, level);
+        Node *&head = m_slots[index];
+        node->timer_prev = nullptr;
+        node->timer_next = head;
+        if (head != nullptr) {
+            head->timer_prev = node;
+        }
+        head = node;
+        node->timer_slot = static_cast<std::uint16_t>(index + 1);
+        m_occupied[level] |= std::uint64_t{1} << (index % slots);
+        ++m_count;
+    }
+
+    void cancel(Node *node) {
+        if (node->timer_slot == 0) {
+            return;
+        }
+        const unsigned index = node->timer_slot - 1;
+        (node->timer_prev != nullptr ? node->timer_prev->timer_next : m_slots[index]) = node->timer_next;
+        if (node->timer_next != nullptr) {
+            node->timer_next->timer_prev = node->timer_prev;
+        }
+        if (m_slots[index] == nullptr) {
+            m_occupied[index / slots] &= ~(std::uint64_t{1} << (index % slots));
+        }
+        node->timer_slot = 0;
+        --m_count;
+    }
+
+    // Moves the clock forward to `target`, passing every node that becomes due to `expire` after unscheduling it.
+    template <class F>
+    void advance(const std::uint64_t target, F &&expire) {
+        while (m_count != 0) {
+            const std::uint64_t event = next_event();
+            if (event > target) {
+                break;
+            }
+            m_now = event;
+            for (unsigned level = levels; level-- > 0;) {
+                if (level > 0 && (m_now & ((std::uint64_t{1} << (level * bits)) - 1)) != 0) {
+                    continue;
+                }
+                const unsigned index = level * slots + digit(m_now, level);
+                Node *node = m_slots[index];
+                m_slots[index] = nullptr;
+                m_occupied[level] &= ~(std::uint64_t{1} << (index % slots));
+                while (node != nullptr) {
+                    Node *next = node->timer_next;
+                    node->timer_slot = 0;
+                    --m_count;
+                    if (node->expires <= m_now) {
+                        expire(node);
+                    } else {
+                        schedule(node);
+                    }
+                    node = next;
+                }
+            }
+        }
+        m_now = std::max(m_now, target);
+    }
+
+private:
+    std::array<Node *, levels * slots> m_slots{};
+    std::array<std::uint64_t, levels> m_occupied{};
+    std::uint64_t m_now = 0;
+    std::size_t m_count = 0;
+
+    static unsigned digit(const std::uint64_t time, const unsigned level) {
+        return static_cast<unsigned>(time >> (level * bits)) & (slots - 1);
+    }
+
+    // Every timer on a level sits in a slot past the current digit of that level, so the earliest due slot of each
+    // level is the first occupied one after it.
+    std::uint64_t next_event() const {
+        std::uint64_t result = std::numeric_limits<std::uint64_t>::max();
+        for (unsigned level = 0; level < levels; ++level) {
+            const unsigned current = digit(m_now, level);
+            const std::uint64_t later = current + 1 == slots ? 0 : m_occupied[level] & (~std::uint64_t{0} << (current + 1));
+            if (later == 0) {
+                continue;
+            }
+            const unsigned shift = level * bits;
+            const std::uint64_t block = shift + bits >= 64 ? 0 : m_now >> (shift + bits) << (shift + bits);
+            result = std::min(result, block | (static_cast<std::uint64_t>(std::countr_zero(later)) << shift));
+        }
+        return result;
+    }
+};
+
+#endif  // ACP_TIMER_WHEEL_HPP
@@ -0,0 +1,134 @@
+#ifndef ACP_WRITE_BACK_HPP
+#define ACP_WRITE_BACK_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded hand-off from cache threads to one background writer, typically fed by a removal listener with the dirty
+// objects the cache lets go of. The writer passes whatever has accumulated, up to `batch_size` items, to `write` in
+// one call. `write` must not throw.
+//
+// Removal listeners run inside the cache's get(), under the shard lock of a ShardedCache, so they must hand items
+// over with try_push(): it never waits, and when the writer has fallen a whole queue behind it counts an overflow and
+// leaves the item to the caller, to be written synchronously or dropped. push() waits for room and is only for
+// threads that hold no cache lock.
+template <class Item>
+class WriteBack {
+public:
+    using Write = std::function<void(std::span<Item>)>;
+
+    WriteBack(const std::size_t capacity, const std::size_t batch_size, Write write)
+        : m_capacity(std::max<std::size_t>(capacity, 1))
+        , m_batch_size(std::max<std::size_t>(batch_size, 1))
+        , m_write(std::move(write))
+        , m_lock()
+        , m_not_empty()
+        , m_not_full()
+        , m_idle()
+        , m_queue()
+        , m_overflows(0)
+        , m_writing(false)
+        , m_stop(false)
+        , m_thread([this] { run(); }) {}
+
+    WriteBack(const WriteBack &) = delete;
+    WriteBack &operator=(const WriteBack &) = delete;
+
+    // Writes everything still queued before returning.
+    ~WriteBack() {
+        {
+            std::lock_guard lock(m_lock);
+            m_stop = true;
+        }
+        m_not_empty.notify_one();
+        m_thread.join();
+    }
+
+    // Waits while the queue is full.
+    void push(Item item) {
+        std::unique_lock lock(m_lock);
+        m_not_full.wait(lock, [this] { return m_queue.size() < m_capacity; });
+        m_queue.push_back(std::move(item));
+        lock.unlock();
+        m_not_empty.notify_one();
+    }
+
+    // Never waits: if the queue is full, counts an overflow and returns false, leaving `item` untouched.
+    bool try_push(Item &item) {
+        std::unique_lock lock(m_lock);
+        if (m_queue.size() == m_capacity) {
+            ++m_overflows;
+            return false;
+        }
+        m_queue.push_back(std::move(item));
+        lock.unlock();
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    // Waits until every item pushed so far has been written.
+    void flush() {
+        std::unique_lock lock(m_lock);
+        m_idle.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+    }
+
+    std::size_t pending() const {
+        std::lock_guard lock(m_lock);
+        return m_queue.size();
+    }
+
+    // How many times try_push() found the queue full.
+    std::size_t overflows() const {
+        std::lock_guard lock(m_lock);
+        return m_overflows;
+    }
+
+private:
+    const std::size_t m_capacity;
+    const std::size_t m_batch_size;
+    Write m_write;
+    mutable std::mutex m_lock;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::condition_variable m_idle;
+    std::deque<Item> m_queue;
+    std::size_t m_overflows;
+    bool m_writing;
+    bool m_stop;
+    std::thread m_thread;
+
+    void run() {
+        std::vector<Item> batch;
+        std::unique_lock lock(m_lock);
+        for (;;) {
+            m_not_empty.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            const std::size_t count = std::min(m_batch_size, m_queue.size());
+            batch.clear();
+            std::move(m_queue.begin(), m_queue.begin() + static_cast<std::ptrdiff_t>(count), std::back_inserter(batch));
+            m_queue.erase(m_queue.begin(), m_queue.begin() + static_cast<std::ptrdiff_t>(count));
+            m_writing = true;
+            lock.unlock();
+            m_not_full.notify_all();
+            m_write(std::span<Item>(batch));
+            lock.lock();
+            m_writing = false;
+            if (m_queue.empty()) {
+                m_idle.notify_all();
+            }
+        }
+    }
+};
+
+#endif  // ACP_WRITE_BACK_HPP
@@ -1,4 +1,9 @@
 #include "acp/Allocator.hpp"
 
-AllocatorWithPool::AllocatorWithPool(const std::size_t size, std::initializer_list<std::size_t> sizes)
-    : PoolAllocator(size, sizes) {}
+AllocatorWithPool::AllocatorWithPool(const std::size_t size, std::initializer_list<std::size_t> sizes,
+                                     const std::size_t max_empty_slabs)
+    : PoolAllocator(size, sizes, max_empty_slabs) {}
+
+AllocatorWithPool::AllocatorWithPool(const std::size_t size, std::vector<std::size_t> sizes,
+                                     const std::size_t max_empty_slabs)
+    : PoolAllocator(size, std::move(sizes), max_empty_slabs) {}
@@ -0,0 +1,75 @@
+#include "acp/FrequencySketch.hpp"
+
+#include <algorithm>
+#include <bit>
+
+FrequencySketch::FrequencySketch(std::size_t const capacity)
+    : _table(std::bit_ceil(std::max<std::size_t>(capacity, 16)) / 4)
+    , _doorkeeper(std::bit_ceil(std::max<std::size_t>(capacity, 64)) / 8)
+    , _sample_size(10 * std::max<std::size_t>(capacity, 1))
+    , _additions(0) {}
+
+std::uint64_t FrequencySketch::rehash(std::size_t const hash, std::size_t const row) {
+    static constexpr std::uint64_t seeds[depth] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+                                                   0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+    std::uint64_t value = (static_cast<std::uint64_t>(hash) + seeds[row]) * 0x9E3779B97F4A7C15ULL;
+    return value ^ (value >> 32);
+}
+
+bool FrequencySketch::doorkeeper_contains(std::size_t const hash) const {
+    std::size_t const bits = _doorkeeper.size() * 64;
+    for (std::size_t row = 0; row < 2; ++row) {
+        std::size_t const bit = rehash(hash, row) & (bits - 1);
+        if ((_doorkeeper[bit / 64] & (std::uint64_t{1} << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FrequencySketch::doorkeeper_put(std::size_t const hash) {
+    std::size_t const bits = _doorkeeper.size() * 64;
+    bool inserted = false;
+    for (std::size_t row = 0; row < 2; ++row) {
+        std::size_t const bit = rehash(hash, row) & (bits - 1);
+        std::uint64_t const mask = std::uint64_t{1} << (bit % 64);
+        inserted |= (_doorkeeper[bit / 64] & mask) == 0;
+        _doorkeeper[bit / 64] |= mask;
+    }
+    return inserted;
+}
+
+void FrequencySketch::record(std::size_t const hash) {
+    if (!doorkeeper_put(hash)) {
+        std::size_t const counters = _table.size() * 16;
+        for (std::size_t row = 0; row < depth; ++row) {
+            std::size_t const counter = rehash(hash, row) & (counters - 1);
+            std::uint64_t& word = _table[counter / 16];
+            std::size_t const shift = (counter % 16) * 4;
+            if (((word >> shift) & max_count) < max_count) {
+                word += std::uint64_t{1} << shift;
+            }
+        }
+    }
+    if (++_additions == _sample_size) {
+        age();
+    }
+}
+
+std::uint32_t FrequencySketch::estimate(std::size_t const hash) const {
+    std::size_t const counters = _table.size() * 16;
+    std::uint32_t result = max_count;
+    for (std::size_t row = 0; row < depth; ++row) {
+        std::size_t const counter = rehash(hash, row) & (counters - 1);
+        result = std::min(result, static_cast<std::uint32_t>((_table[counter / 16] >> (counter % 16 * 4)) & max_count));
+    }
+    return result + (doorkeeper_contains(hash) ? 1 : 0);
+}
+
+void FrequencySketch::age() {
+    for (std::uint64_t& word : _table) {
+        word = (word >> 1) & 0x7777777777777777ULL;
+    }
+    std::fill(_doorkeeper.begin(), _doorkeeper.end(), 0);
+    _additions /= 2;
+}
@@ -1,43 +1,658 @@
 #include "acp/Pool.hpp"
 
-PoolAllocator::PoolAllocator(std::size_t const block_size, std::initializer_list<std::size_t> list)
-    : _data(list.size(), std::vector<std::byte>(block_size)), _used(list.size()), _block_pos() {
-    std::size_t pos = 0;
-    for (std::size_t value_size : list) {
-        _used[pos].resize(block_size / value_size);
-        _block_pos[value_size] = pos++;
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef ACP_POOL_DEBUG
+#include <execinfo.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#endif
+
+namespace {
+
+std::atomic<std::uint64_t> next_pool_id{0};
+
+constexpr std::size_t quantum = alignof(void*);
+
+std::size_t slot_size_for(std::size_t const size) {
+    std::size_t const slot = std::max(size, sizeof(void*));
+    return (slot + quantum - 1) / quantum * quantum;
+}
+
+void*& next_of(void* slot) { return *static_cast<void**>(slot); }
+
+// Shared stack heads keep the top slot's address, less the bits its alignment leaves zero, in the low bits and a
+// modification counter of `tag_bits` above them.
+constexpr unsigned address_bits = sizeof(void*) < 8 ? 32 : 48;
+constexpr unsigned slot_shift = std::countr_zero(quantum);
+constexpr unsigned tag_shift = address_bits - slot_shift;
+
+void* stack_top(std::uint64_t const head) {
+    auto const address = (head & ((std::uint64_t{1} << tag_shift) - 1)) << slot_shift;
+    return reinterpret_cast<void*>(static_cast<std::uintptr_t>(address));
+}
+
+std::uint64_t stack_head(void* top, std::uint64_t const previous) {
+    return ((previous >> tag_shift) + 1) << tag_shift | reinterpret_cast<std::uintptr_t>(top) >> slot_shift;
+}
+
+// Link of a shared stack top, which its new owner may already be writing to; the exchange that follows discards
+// such a value, so the read is kept out of ThreadSanitizer's sight. The builtin, unlike std::atomic_ref, is not
+// instrumented inside such a function.
+#if defined(__GNUC__)
+__attribute__((no_sanitize("thread"), noinline)) void* speculative_next(void* slot) {
+    return __atomic_load_n(static_cast<void**>(slot), __ATOMIC_RELAXED);
+}
+#else
+void* speculative_next(void* slot) { return std::atomic_ref<void*>(next_of(slot)).load(std::memory_order_relaxed); }
+#endif
+
+constexpr std::size_t huge_page_size = std::size_t{2} << 20;
+
+std::size_t page_size() {
+    static std::size_t const size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// The kernel only promises page alignment, so `align` more than the size is reserved and both ends are trimmed.
+void* map_aligned(std::size_t const size, std::size_t const align, int const flags) {
+    void* raw = ::mmap(nullptr, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
     }
+    auto const begin = reinterpret_cast<std::uintptr_t>(raw);
+    auto const aligned = (begin + align - 1) & ~(align - 1);
+    if (aligned != begin) {
+        ::munmap(raw, aligned - begin);
+    }
+    ::munmap(reinterpret_cast<void*>(aligned + size), begin + align - aligned);
+    return reinterpret_cast<void*>(aligned);
 }
 
-void* PoolAllocator::allocate(std::size_t const size) {
-    auto position = find_free(size);
-    if (position == invalid_pos) {
+// `hugetlb` tells whether the mapping is backed by explicit huge pages.
+void* map_slab(std::size_t const size, bool const huge_pages, bool& hugetlb) {
+#ifdef MAP_HUGETLB
+    if (huge_pages && size % huge_page_size == 0) {
+        if (void* data = map_aligned(size, size, MAP_HUGETLB)) {
+            hugetlb = true;
+            return data;
+        }
+    }
+#endif
+    hugetlb = false;
+    void* data = map_aligned(size, size, 0);
+    if (data == nullptr) {
         throw std::bad_alloc();
     }
-    _used[position.first][position.second / size] = true;
-    return &_data[position.first][position.second];
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+        ::madvise(data, size, MADV_HUGEPAGE);
+    }
+#endif
+    return data;
+}
+
+}  // anonymous namespace
+
+PoolAllocator::PoolAllocator(std::size_t const block_size, std::initializer_list<std::size_t> list,
+                             std::size_t const max_empty_slabs)
+    : PoolAllocator(block_size, std::vector<std::size_t>(list), max_empty_slabs) {}
+
+PoolAllocator::PoolAllocator(std::size_t const block_size, std::vector<std::size_t> sizes,
+                             std::size_t const max_empty_slabs)
+    : _slab_align(std::bit_ceil(std::max({block_size, 2 * sizeof(Slab), page_size()})))
+    , _max_empty_slabs(max_empty_slabs)
+    , _decay_time(std::chrono::seconds(10))
+    , _next_purge()
+    , _huge_pages(false)
+    , _classes()
+    , _class_index()
+    , _id(next_pool_id.fetch_add(1, std::memory_order_relaxed))
+    , _depot_lock()
+    , _thread_caches()
+    , _remote_free(nullptr)
+    , _shared() {
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    std::size_t const usable = _slab_align - sizeof(Slab);
+    for (std::size_t value_size : sizes) {
+        std::size_t const slot_size = slot_size_for(value_size);
+        if (value_size == 0 || slot_size > usable || _classes.size() == std::numeric_limits<std::uint16_t>::max()) {
+            continue;
+        }
+        _classes.push_back({value_size, slot_size, usable / slot_size, nullptr, nullptr, nullptr, 0});
+    }
+    // One entry per quantum up to the biggest listed slot: the first class whose slots are at least that large.
+    if (!_classes.empty()) {
+        _class_index.resize(_classes.back().slot_size / quantum + 1);
+        std::uint16_t size_class = 0;
+        for (std::size_t i = 0; i < _class_index.size(); ++i) {
+            while (_classes[size_class].slot_size < i * quantum) {
+                ++size_class;
+            }
+            _class_index[i] = size_class;
+        }
+    }
+    // Past the listed sizes, powers of two up to a single slot filling the whole slab, so that only objects larger
+    // than a slab need a mapping of their own.
+    std::size_t size = std::bit_ceil(std::max(_classes.empty() ? 0 : _classes.back().slot_size + 1, quantum));
+    for (; size < usable && _classes.size() < std::numeric_limits<std::uint16_t>::max(); size *= 2) {
+        _classes.push_back({size, size, usable / size, nullptr, nullptr, nullptr, 0});
+    }
+    if ((_classes.empty() || _classes.back().slot_size < usable) &&
+        _classes.size() < std::numeric_limits<std::uint16_t>::max()) {
+        _classes.push_back({usable, usable, 1, nullptr, nullptr, nullptr, 0});
+    }
+#ifdef ACP_POOL_STATS
+    _counters = std::make_unique<Counters[]>(_classes.size() + 1);
+#endif
+}
+
+std::vector<std::size_t> PoolAllocator::geometric_classes(std::size_t const max_size, std::size_t const steps) {
+    std::size_t const quantum = sizeof(void*);
+    std::vector<std::size_t> classes;
+    for (std::size_t size = quantum; size <= max_size; size += std::max(quantum, std::bit_floor(size) / steps)) {
+        classes.push_back(size);
+    }
+    return classes;
+}
+
+PoolAllocator::~PoolAllocator() {
+#ifdef ACP_POOL_DEBUG
+    report_leaks();
+#endif
+    // Queued frees and magazines only ever hold slab slots, so slab memory can go away wholesale.
+    for (SizeClass& cls : _classes) {
+        free_slabs(cls.partial);
+        free_slabs(cls.full);
+        free_slabs(cls.empty);
+    }
+}
+
+std::size_t PoolAllocator::find_class(std::size_t const size) const {
+    // Rounded up without adding first, which would wrap sizes near SIZE_MAX around to a small class.
+    std::size_t const index = size / quantum + (size % quantum != 0 ? 1 : 0);
+    if (index < _class_index.size()) {
+        return _class_index[index];
+    }
+    // The classes beyond the table are few and sorted.
+    return static_cast<std::size_t>(
+        std::partition_point(_classes.begin(), _classes.end(),
+                             [size](SizeClass const& cls) { return cls.slot_size < size; }) -
+        _classes.begin());
+}
+
+PoolAllocator::Slab& PoolAllocator::slab_of(void const* ptr) const {
+    return *reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(_slab_align - 1));
+}
+
+PoolAllocator::ThreadCache& PoolAllocator::thread_cache() {
+    // Keyed by pool id rather than address, so a new pool reusing the storage of a destroyed one never picks up
+    // its stale cache.
+    struct Registry {
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<ThreadCache>>> caches;
+
+        ~Registry() {
+            for (auto& entry : caches) {
+                entry.second->detached.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Registry registry;
+
+    for (auto& [id, cache] : registry.caches) {
+        if (id == _id) {
+            return *cache;
+        }
+    }
+    std::erase_if(registry.caches, [](auto const& entry) { return entry.second.use_count() == 1; });
+    auto cache = std::make_shared<ThreadCache>();
+    cache->magazines.resize(_classes.size());
+    {
+        std::lock_guard lock(_depot_lock);
+        _thread_caches.push_back(cache);
+    }
+    registry.caches.emplace_back(_id, cache);
+    return *cache;
+}
+
+void* PoolAllocator::allocate(std::size_t const size) { return allocate_class(find_class(size), size); }
+
+void* PoolAllocator::allocate_class(std::size_t const size_class, std::size_t const size) {
+#ifdef ACP_POOL_STATS
+    void* ptr;
+    try {
+        ptr = allocate_in(size_class, size);
+    } catch (std::bad_alloc const&) {
+        _counters[size_class].failures.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+    count_allocation(size_class);
+#ifdef ACP_POOL_DEBUG
+    remember(ptr);
+#endif
+    return ptr;
+#else
+    return allocate_in(size_class, size);
+#endif
+}
+
+void* PoolAllocator::allocate_in(std::size_t const size_class, std::size_t const size) {
+    if (size_class == _classes.size()) {
+        // Objects larger than a slab get a mapping of their own, with a header at its aligned start that masking
+        // finds just like a slab's.
+        std::size_t const length = (sizeof(Slab) + size + _slab_align - 1) & ~(_slab_align - 1);
+        void* data = length < size ? nullptr : map_aligned(length, _slab_align, 0);
+        if (data == nullptr) {
+            throw std::bad_alloc();
+        }
+        Slab* header = ::new (data) Slab{nullptr, 0, length, large_class, nullptr, nullptr, {}, false, false};
+        return header + 1;
+    }
+    Magazine& magazine = thread_cache().magazines[size_class];
+    if (magazine.count == 0 && _shared) {
+        while (magazine.count < magazine_size / 2) {
+            void* ptr = pop_shared(size_class);
+            if (ptr == nullptr) {
+                break;
+            }
+            magazine.slots[magazine.count++] = ptr;
+        }
+    }
+    if (magazine.count == 0) {
+        refill(magazine, size_class);
+    }
+    return magazine.slots[--magazine.count];
 }
 
 void PoolAllocator::deallocate(void const* ptr) {
-    for (auto& [size, pos] : _block_pos) {
-        for (std::size_t j = 0; j < _used[pos].size(); ++j) {
-            if (_used[pos][j] && &_data[pos][j * size] == ptr) {
-                _used[pos][j] = false;
-                return;
+    if (ptr == nullptr) {
+        return;
+    }
+    Slab& slab = slab_of(ptr);
+#ifdef ACP_POOL_STATS
+    Counters& counters = _counters[slab.size_class == large_class ? _classes.size() : slab.size_class];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.live.fetch_sub(1, std::memory_order_relaxed);
+#ifdef ACP_POOL_DEBUG
+    forget(ptr);
+#endif
+#endif
+    if (slab.size_class == large_class) {
+        ::munmap(&slab, slab.carved);
+        return;
+    }
+    // The size class of a slab is fixed while any of its slots is live, so reading it needs no lock.
+    ThreadCache& cache = thread_cache();
+    Magazine& magazine = cache.magazines[slab.size_class];
+    if (magazine.count < magazine_size) {
+        magazine.slots[magazine.count++] = const_cast<void*>(ptr);
+        return;
+    }
+    if (_shared) {
+        // Half of the magazine goes to the shared stack as one chain.
+        for (std::size_t i = magazine_size / 2; i + 1 < magazine_size; ++i) {
+            next_of(magazine.slots[i]) = magazine.slots[i + 1];
+        }
+        push_shared(slab.size_class, magazine.slots[magazine_size / 2], magazine.slots[magazine_size - 1]);
+        magazine.count = magazine_size / 2;
+        magazine.slots[magazine.count++] = const_cast<void*>(ptr);
+        return;
+    }
+    cache.freed[cache.pending++] = const_cast<void*>(ptr);
+    if (cache.pending == free_batch) {
+        flush(cache);
+    }
+}
+
+std::vector<PoolAllocator::Occupancy> PoolAllocator::occupancy() {
+    std::vector<Occupancy> result;
+    result.reserve(_classes.size());
+    for (SizeClass const& cls : _classes) {
+        result.push_back({cls.size, 0, 0, 0});
+    }
+    std::lock_guard lock(_depot_lock);
+    for (std::size_t i = 0; i < _classes.size(); ++i) {
+        Occupancy& usage = result[i];
+        for (Slab* head : {_classes[i].partial, _classes[i].full, _classes[i].empty}) {
+            for (Slab* slab = head; slab != nullptr; slab = slab->next) {
+                ++usage.slabs;
+                usage.used += slab->used;
+                usage.capacity += _classes[i].capacity;
+            }
+        }
+    }
+    return result;
+}
+
+void PoolAllocator::enable_huge_pages(bool const enable) {
+    std::lock_guard lock(_depot_lock);
+    _huge_pages = enable;
+}
+
+void PoolAllocator::enable_shared_mode() {
+    static_assert(tag_shift + tag_bits == 64, "stack heads have to be packed as documented");
+    std::lock_guard lock(_depot_lock);
+    if (_shared) {
+        return;
+    }
+    if (!_thread_caches.empty()) {
+        throw std::logic_error("shared mode has to be enabled before the pool is used");
+    }
+    _shared = std::make_unique<SharedStack[]>(_classes.size());
+}
+
+void PoolAllocator::set_decay_time(std::chrono::steady_clock::duration const decay_time) {
+    std::lock_guard lock(_depot_lock);
+    _decay_time = decay_time;
+    _next_purge = {};
+}
+
+void PoolAllocator::refill(Magazine& magazine, std::size_t const size_class) {
+    std::lock_guard lock(_depot_lock);
+    drain_remote();
+    reclaim_detached();
+    purge_empty();
+    magazine.slots[magazine.count++] = take(size_class);
+    // At most a slab's worth, so that classes of few huge slots don't map several slabs ahead.
+    std::size_t const batch = std::min(magazine_size / 2, _classes[size_class].capacity);
+    try {
+        while (magazine.count < batch) {
+            magazine.slots[magazine.count++] = take(size_class);
+        }
+    } catch (std::bad_alloc const&) {
+        // One slot is enough to serve the current request.
+    }
+}
+
+void PoolAllocator::flush(ThreadCache& cache) {
+    std::unique_lock lock(_depot_lock, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        // Don't wait for the depot: hand the whole batch over to whichever thread holds it next.
+        for (std::size_t i = 0; i + 1 < cache.pending; ++i) {
+            next_of(cache.freed[i]) = cache.freed[i + 1];
+        }
+        void* last = cache.freed[cache.pending - 1];
+        next_of(last) = _remote_free.load(std::memory_order_relaxed);
+        while (!_remote_free.compare_exchange_weak(next_of(last), cache.freed[0], std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+        }
+        cache.pending = 0;
+        return;
+    }
+    for (std::size_t i = 0; i < cache.pending; ++i) {
+        give(cache.freed[i], &cache);
+    }
+    cache.pending = 0;
+    drain_remote();
+    reclaim_detached();
+    purge_empty();
+}
+
+void PoolAllocator::drain_remote() {
+    void* ptr = _remote_free.exchange(nullptr, std::memory_order_acquire);
+    while (ptr != nullptr) {
+        void* next = next_of(ptr);
+        give(ptr, nullptr);
+        ptr = next;
+    }
+}
+
+void PoolAllocator::reclaim_detached() {
+    std::erase_if(_thread_caches, [this](std::shared_ptr<ThreadCache> const& cache) {
+        if (!cache->detached.load(std::memory_order_acquire)) {
+            return false;
+        }
+        for (std::size_t size_class = 0; size_class < cache->magazines.size(); ++size_class) {
+            Magazine& magazine = cache->magazines[size_class];
+            for (std::size_t i = 0; i < magazine.count; ++i) {
+                if (_shared) {
+                    next_of(magazine.slots[i]) = nullptr;
+                    push_shared(size_class, magazine.slots[i], magazine.slots[i]);
+                } else {
+                    give(magazine.slots[i], nullptr);
+                }
             }
         }
+        for (std::size_t i = 0; i < cache->pending; ++i) {
+            give(cache->freed[i], nullptr);
+        }
+        return true;
+    });
+}
+
+void* PoolAllocator::take(std::size_t const size_class) {
+    SizeClass& cls = _classes[size_class];
+    if (cls.partial == nullptr) {
+        if (cls.empty != nullptr) {
+            Slab& slab = *cls.empty;
+            unlink(cls.empty, slab);
+            --cls.empty_count;
+            link(cls.partial, slab);
+        } else {
+            new_slab(size_class);
+        }
+    }
+    Slab& slab = *cls.partial;
+    void* ptr = slab.free;
+    if (ptr != nullptr) {
+        slab.free = next_of(ptr);
+    } else {
+        ptr = reinterpret_cast<std::byte*>(&slab + 1) + slab.carved++ * cls.slot_size;
+    }
+    if (++slab.used == cls.capacity) {
+        unlink(cls.partial, slab);
+        link(cls.full, slab);
+    }
+    return ptr;
+}
+
+void PoolAllocator::give(void* ptr, ThreadCache* cache) {
+    Slab& slab = slab_of(ptr);
+    if (cache != nullptr) {
+        Magazine& magazine = cache->magazines[slab.size_class];
+        if (magazine.count < magazine_size) {
+            magazine.slots[magazine.count++] = ptr;
+            return;
+        }
+    }
+    SizeClass& cls = _classes[slab.size_class];
+    next_of(ptr) = slab.free;
+    slab.free = ptr;
+    if (slab.used-- == cls.capacity) {
+        unlink(cls.full, slab);
+        link(cls.partial, slab);
+    }
+    if (slab.used != 0) {
+        return;
+    }
+    unlink(cls.partial, slab);
+    if (cls.empty_count == _max_empty_slabs) {
+        release_slab(slab);
+        return;
+    }
+    link(cls.empty, slab);
+    ++cls.empty_count;
+    slab.empty_since = std::chrono::steady_clock::now();
+    slab.purged = false;
+    if (_decay_time <= std::chrono::steady_clock::duration::zero()) {
+        purge_slab(slab);
     }
 }
 
-PoolAllocator::pos_type PoolAllocator::find_free(std::size_t const size) {
-    if (!_block_pos.contains(size)) {
-        return invalid_pos;
+PoolAllocator::Slab& PoolAllocator::new_slab(std::size_t const size_class) {
+    // Slabs are aligned to their size, so masking any slot address yields the slab base. Fresh mappings are faulted
+    // in lazily as slots get carved.
+    bool hugetlb;
+    void* data = map_slab(_slab_align, _huge_pages, hugetlb);
+    if (_shared && (reinterpret_cast<std::uintptr_t>(data) + _slab_align - 1) >> address_bits != 0) {
+        // Beyond the range the stack heads can address.
+        ::munmap(data, _slab_align);
+        throw std::bad_alloc();
+    }
+    Slab& slab = *::new (data) Slab{nullptr, 0, 0, size_class, nullptr, nullptr, {}, false, hugetlb};
+    link(_classes[size_class].partial, slab);
+#ifdef ACP_POOL_STATS
+    _counters[size_class].slabs.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return slab;
+}
+
+void PoolAllocator::release_slab(Slab& slab) {
+#ifdef ACP_POOL_STATS
+    _counters[slab.size_class].slabs.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    ::munmap(&slab, _slab_align);
+}
+
+void PoolAllocator::purge_slab(Slab& slab) {
+    // The header page stays resident; every slot is free, so carving simply starts over on the zeroed pages.
+    // Explicit huge pages cannot be given back in part, so such a slab, or one the kernel refuses to purge, is
+    // unmapped instead.
+    std::size_t const page = page_size();
+    if (slab.hugetlb || ::madvise(reinterpret_cast<std::byte*>(&slab) + page, _slab_align - page, MADV_DONTNEED) != 0) {
+        SizeClass& cls = _classes[slab.size_class];
+        unlink(cls.empty, slab);
+        --cls.empty_count;
+        release_slab(slab);
+        return;
+    }
+    slab.free = nullptr;
+    slab.carved = 0;
+    slab.purged = true;
+}
+
+void PoolAllocator::purge_empty() {
+    auto const now = std::chrono::steady_clock::now();
+    if (now < _next_purge) {
+        return;
+    }
+    _next_purge = now + _decay_time / 2;
+    for (SizeClass& cls : _classes) {
+        for (Slab* slab = cls.empty; slab != nullptr;) {
+            Slab* next = slab->next;
+            if (!slab->purged && now - slab->empty_since >= _decay_time) {
+                purge_slab(*slab);
+            }
+            slab = next;
+        }
+    }
+}
+
+void PoolAllocator::free_slabs(Slab* head) {
+    while (head != nullptr) {
+        Slab* next = head->next;
+        release_slab(*head);
+        head = next;
+    }
+}
+
+void PoolAllocator::push_shared(std::size_t const size_class, void* first, void* last) {
+    std::atomic<std::uint64_t>& head = _shared[size_class].head;
+    std::uint64_t top = head.load(std::memory_order_relaxed);
+    do {
+        std::atomic_ref<void*>(next_of(last)).store(stack_top(top), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(top, stack_head(first, top), std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+void* PoolAllocator::pop_shared(std::size_t const size_class) {
+    // The top may be popped and handed out concurrently, so its link can be garbage by the time it is read; the
+    // read itself is safe because slabs stay mapped in shared mode, and the counter makes the exchange fail.
+    std::atomic<std::uint64_t>& head = _shared[size_class].head;
+    std::uint64_t top = head.load(std::memory_order_acquire);
+    while (void* slot = stack_top(top)) {
+        void* next = speculative_next(slot);
+        if (head.compare_exchange_weak(top, stack_head(next, top), std::memory_order_acquire,
+                                       std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+void PoolAllocator::link(Slab*& head, Slab& slab) {
+    slab.prev = nullptr;
+    slab.next = head;
+    if (head != nullptr) {
+        head->prev = &slab;
+    }
+    head = &slab;
+}
+
+void PoolAllocator::unlink(Slab*& head, Slab& slab) {
+    (slab.prev != nullptr ? slab.prev->next : head) = slab.next;
+    if (slab.next != nullptr) {
+        slab.next->prev = slab.prev;
+    }
+}
+
+#ifdef ACP_POOL_STATS
+std::vector<PoolAllocator::Profile> PoolAllocator::profile() const {
+    std::vector<Profile> result;
+    result.reserve(_classes.size() + 1);
+    for (std::size_t i = 0; i <= _classes.size(); ++i) {
+        Counters const& counters = _counters[i];
+        result.push_back({i < _classes.size() ? _classes[i].size : 0, counters.live.load(std::memory_order_relaxed),
+                          counters.peak.load(std::memory_order_relaxed),
+                          counters.allocations.load(std::memory_order_relaxed),
+                          counters.frees.load(std::memory_order_relaxed),
+                          counters.failures.load(std::memory_order_relaxed),
+                          counters.slabs.load(std::memory_order_relaxed)});
+    }
+    return result;
+}
+
+void PoolAllocator::count_allocation(std::size_t const size_class) {
+    Counters& counters = _counters[size_class];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t const live = counters.live.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::size_t peak = counters.peak.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+#endif
+
+#ifdef ACP_POOL_DEBUG
+void PoolAllocator::remember(void const* ptr) {
+    // Skips this frame and allocate itself.
+    std::array<void*, call_depth + 2> frames;
+    auto const depth = static_cast<std::size_t>(::backtrace(frames.data(), static_cast<int>(frames.size())));
+    CallSite site{depth > 2 ? depth - 2 : 0, {}};
+    std::copy_n(frames.begin() + static_cast<std::ptrdiff_t>(depth - site.depth), site.depth, site.frames.begin());
+    std::lock_guard lock(_sites_lock);
+    _sites[ptr] = site;
+}
+
+void PoolAllocator::forget(void const* ptr) {
+    std::lock_guard lock(_sites_lock);
+    _sites.erase(ptr);
+}
+
+void PoolAllocator::report_leaks() {
+    if (_sites.empty()) {
+        return;
+    }
+    std::map<std::vector<void*>, std::size_t> counts;
+    for (auto const& [ptr, site] : _sites) {
+        ++counts[std::vector<void*>(site.frames.begin(), site.frames.begin() + static_cast<std::ptrdiff_t>(site.depth))];
     }
-    std::size_t i = _block_pos[size];
-    for (std::size_t j = 0; j < _used[i].size(); ++j) {
-        if (!_used[i][j]) {
-            return std::make_pair(i, j * size);
+    std::cerr << "PoolAllocator: " << _sites.size() << " objects still live at destruction\n";
+    for (auto const& [frames, count] : counts) {
+        std::cerr << "  " << count << " allocated at:\n";
+        char** symbols = ::backtrace_symbols(frames.data(), static_cast<int>(frames.size()));
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            std::cerr << "    " << (symbols != nullptr ? symbols[i] : "?") << "\n";
         }
+        std::free(symbols);
     }
-    return invalid_pos;
 }
+#endif
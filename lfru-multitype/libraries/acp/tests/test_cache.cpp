@@ -0,0 +1,561 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "acp/Allocator.hpp"
+#include "acp/Cache.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+struct Named {
+    std::string key;
+    int mark = 0;
+
+    explicit Named(std::string_view key) : key(key) {}
+
+    bool operator==(std::string_view other) const { return key == other; }
+
+    friend std::ostream &operator<<(std::ostream &strm, const Named &named) { return strm << named.key; }
+};
+
+struct Small: Named {
+    using Named::Named;
+};
+
+struct Large: Named {
+    using Named::Named;
+    char payload[512] = {};
+};
+
+// Weighs as much as the number after the last '/' of its key.
+struct Blob: Named {
+    explicit Blob(std::string_view key) : Named(key), size(std::stoul(std::string(key.substr(key.rfind('/') + 1)))) {}
+
+    std::size_t weight() const { return size; }
+
+    std::size_t size;
+};
+
+struct Point {
+    int key;
+    double x;
+
+    explicit Point(int key) : key(key), x(key * 0.5) {}
+
+    bool operator==(int other) const { return key == other; }
+
+    friend std::ostream &operator<<(std::ostream &strm, const Point &point) { return strm << point.key << "/" << point.x; }
+};
+
+using TestCache = Cache<std::string, Named, AllocatorWithPool, StringHash>;
+
+using PointCache = Cache<int, Point, AllocatorWithPool>;
+
+constexpr std::size_t block_size = 1 << 16;
+
+TestCache make_cache(const std::size_t cache_size) {
+    return TestCache(cache_size, block_size, PoolAllocator::geometric_classes(1024));
+}
+
+std::string print(const TestCache &cache) {
+    std::ostringstream strm;
+    strm << cache;
+    return strm.str();
+}
+
+std::filesystem::path snapshot_path() {
+    return std::filesystem::temp_directory_path() /
+           (std::string("acp_") + ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".snap");
+}
+
+std::vector<char> read_file(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+}
+
+void write_file(const std::filesystem::path &path, const std::vector<char> &bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+}  // namespace
+
+TEST(CacheTest, miss_then_hit) {
+    TestCache cache(4, block_size, std::initializer_list<std::size_t>{TestCache::entry_size<Small>()});
+    Small &first = cache.get<Small>("a");
+    Small &second = cache.get<Small>("a");
+    ASSERT_EQ(&first, &second);
+    ASSERT_EQ(cache.size(), 1u);
+    ASSERT_EQ(cache.stats().misses, 1u);
+    ASSERT_EQ(cache.stats().hits(), 1u);
+}
+
+TEST(CacheTest, entries_are_found_among_many) {
+    TestCache cache(1000, block_size, std::initializer_list<std::size_t>{TestCache::entry_size<Small>()});
+    std::vector<Small *> objects;
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(&cache.get<Small>(std::to_string(i)));
+    }
+    for (int i = 999; i >= 0; --i) {
+        ASSERT_EQ(&cache.get<Small>(std::to_string(i)), objects[i]);
+    }
+    ASSERT_EQ(cache.size(), 1000u);
+}
+
+TEST(CacheTest, frequently_used_survive_a_scan) {
+    TestCache cache = make_cache(2);
+    cache.get<Small>("hot");
+    cache.get<Small>("hot").mark = 1;
+    for (int i = 0; i < 100; ++i) {
+        cache.get<Small>("scan" + std::to_string(i));
+    }
+    ASSERT_EQ(cache.get<Small>("hot").mark, 1);
+    ASSERT_EQ(cache.size(), 3u);
+}
+
+TEST(CacheTest, demoted_entries_leave_through_the_regular_segment) {
+    TestCache cache = make_cache(2);
+    for (const char *key : {"a", "b", "c"}) {
+        cache.get<Small>(key);
+        cache.get<Small>(key).mark = 1;
+    }
+    // Promoting "c" pushed "a" out of the priority segment, to the front of the regular one.
+    ASSERT_EQ(cache.size(), 3u);
+    cache.get<Small>("d");
+    cache.get<Small>("e");
+    ASSERT_EQ(cache.size(), 4u);
+    ASSERT_EQ(cache.get<Small>("c").mark, 1);
+    ASSERT_EQ(cache.get<Small>("b").mark, 1);
+    ASSERT_EQ(cache.get<Small>("a").mark, 0);
+}
+
+TEST(CacheTest, prints_segments_and_counts_events) {
+    TestCache cache = make_cache(2);
+    ASSERT_EQ(print(cache), "Priority: <empty>\nRegular: <empty>\n");
+    for (const char *key : {"a", "b", "a", "c"}) {
+        cache.get<Small>(key);
+    }
+    ASSERT_EQ(print(cache), "Priority: a\nRegular: c b\n");
+    cache.get<Small>("d");
+    ASSERT_EQ(print(cache), "Priority: a\nRegular: d c\n");
+    const CacheStats &stats = cache.stats();
+    ASSERT_EQ(stats.misses, 4u);
+    ASSERT_EQ(stats.regular_hits, 1u);
+    ASSERT_EQ(stats.priority_hits, 0u);
+    ASSERT_EQ(stats.promotions, 1u);
+    ASSERT_EQ(stats.evictions, 1u);
+    cache.reset_stats();
+    ASSERT_EQ(cache.stats().lookups(), 0u);
+}
+
+TEST(CacheTest, admission_filter_rejects_keys_seen_less_often_than_the_victim) {
+    TestCache cache = make_cache(2);
+    cache.enable_admission_filter();
+    cache.get<Small>("a").mark = 1;
+    cache.get<Small>("b").mark = 1;
+    Small &rejected = cache.get<Small>("x");
+    ASSERT_EQ(rejected.key, "x");
+    ASSERT_EQ(cache.stats().rejections, 1u);
+    ASSERT_EQ(cache.size(), 2u);
+    // Seen twice, "x" now beats the regular tail.
+    cache.get<Small>("x").mark = 2;
+    ASSERT_EQ(cache.stats().rejections, 1u);
+    ASSERT_EQ(cache.get<Small>("x").mark, 2);
+    ASSERT_EQ(cache.get<Small>("b").mark, 1);
+    ASSERT_EQ(cache.get<Small>("a").mark, 0);
+}
+
+TEST(CacheTest, admission_filter_resists_one_off_keys) {
+    const auto hit_ratio = [](const bool admission) {
+        TestCache cache = make_cache(50);
+        cache.enable_admission_filter(admission);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<> uniform(0.0, 1.0);
+        for (int i = 0; i < 100000; ++i) {
+            // Four in five lookups go to a skewed set of 100 keys, the rest to keys never seen again.
+            if (random() % 5 != 0) {
+                const double u = uniform(random);
+                cache.get<Small>("hot" + std::to_string(static_cast<int>(u * u * 100)));
+            } else {
+                cache.get<Small>("once" + std::to_string(i));
+            }
+        }
+        return cache.stats().hit_ratio();
+    };
+    ASSERT_GT(hit_ratio(true), hit_ratio(false) + 0.05);
+}
+
+TEST(CacheTest, adaptive_split_moves_capacity_between_segments) {
+    TestCache cache = make_cache(100);
+    cache.enable_adaptive_split();
+    std::mt19937 random(3);
+    bool moved = false;
+    for (int i = 0; i < 50000; ++i) {
+        cache.get<Small>(std::to_string(random() % 400));
+        moved |= cache.priority_capacity() != 100;
+        ASSERT_EQ(cache.priority_capacity() + cache.regular_capacity(), 200u);
+        ASSERT_GE(cache.priority_capacity(), 1u);
+        ASSERT_GE(cache.regular_capacity(), 1u);
+    }
+    ASSERT_TRUE(moved);
+    ASSERT_LE(cache.size(), 200u);
+    cache.enable_adaptive_split(false);
+    ASSERT_EQ(cache.priority_capacity(), 100u);
+    ASSERT_EQ(cache.regular_capacity(), 100u);
+    ASSERT_LE(cache.size(), 200u);
+}
+
+TEST(CacheTest, weighted_eviction_keeps_the_budget) {
+    TestCache cache = make_cache(100);
+    for (int i = 0; i < 60; ++i) {
+        cache.get<Blob>(std::to_string(i % 20) + "/" + std::to_string(10 + i % 7 * 5));
+        ASSERT_LE(cache.weight(), 200u);
+    }
+    // Four objects of weight 30 overflow the regular segment: the oldest is evicted.
+    TestCache fresh = make_cache(100);
+    for (const char *key : {"w/30", "x/30", "y/30", "z/30"}) {
+        fresh.get<Blob>(key).mark = 1;
+    }
+    ASSERT_EQ(fresh.weight(), 90u);
+    ASSERT_EQ(fresh.stats().evictions, 1u);
+    ASSERT_EQ(fresh.get<Blob>("x/30").mark, 1);
+    ASSERT_EQ(fresh.get<Blob>("w/30").mark, 0);
+}
+
+TEST(CacheTest, object_heavier_than_a_segment_is_not_cached) {
+    TestCache cache = make_cache(100);
+    cache.get<Blob>("a/10");
+    Blob &heavy = cache.get<Blob>("h/150");
+    ASSERT_EQ(heavy.key, "h/150");
+    ASSERT_EQ(cache.size(), 1u);
+    ASSERT_EQ(cache.weight(), 10u);
+    ASSERT_EQ(cache.stats().rejections, 1u);
+}
+
+TEST(CacheTest, adaptive_split_samples_entries_not_weight) {
+    // About a hundred objects of weight 1000: samples are as long as for a hundred unweighted entries.
+    TestCache cache = make_cache(50000);
+    cache.enable_adaptive_split();
+    std::mt19937 random(3);
+    std::size_t moves = 0;
+    std::size_t capacity = cache.priority_capacity();
+    for (int i = 0; i < 50000; ++i) {
+        cache.get<Blob>(std::to_string(random() % 400) + "/1000");
+        if (cache.priority_capacity() != capacity) {
+            capacity = cache.priority_capacity();
+            ++moves;
+        }
+        ASSERT_EQ(cache.priority_capacity() + cache.regular_capacity(), 100000u);
+    }
+    ASSERT_GE(moves, 10u);
+}
+
+TEST(CacheTest, time_to_live) {
+    TestCache cache = make_cache(8);
+    cache.set_time_to_live(std::chrono::seconds(10));
+    cache.get<Small>("a");
+    cache.get<Small>("b");
+    ASSERT_EQ(cache.expire(TestCache::Clock::now()), 0u);
+    ASSERT_EQ(cache.expire(TestCache::Clock::now() + std::chrono::seconds(11)), 2u);
+    ASSERT_TRUE(cache.empty());
+    ASSERT_EQ(cache.stats().expirations, 2u);
+}
+
+TEST(CacheTest, get_many_matches_get) {
+    TestCache cache = make_cache(64);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 50; ++i) {
+        keys.push_back(std::to_string(i % 30));
+    }
+    std::vector<Small *> out(keys.size());
+    ASSERT_EQ(cache.get_many<Small>(keys, out), keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_NE(out[i], nullptr);
+        ASSERT_EQ(out[i]->key, keys[i]);
+        ASSERT_EQ(out[i], &cache.get<Small>(keys[i]));
+    }
+    ASSERT_EQ(cache.stats().misses, 30u);
+}
+
+TEST(CacheTest, get_many_needs_an_output_for_every_key) {
+    TestCache cache = make_cache(4);
+    const std::vector<std::string> keys = {"a", "b", "c"};
+    std::vector<Small *> out(2);
+    ASSERT_THROW(cache.get_many<Small>(keys, out), std::invalid_argument);
+    ASSERT_TRUE(cache.empty());
+}
+
+TEST(CacheTest, get_many_stops_before_evicting_what_it_handed_out) {
+    TestCache cache = make_cache(4);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 20; ++i) {
+        keys.push_back(std::to_string(i));
+    }
+    std::vector<Small *> out(keys.size());
+    std::size_t done = 0;
+    std::size_t calls = 0;
+    while (done < keys.size()) {
+        const std::size_t served = cache.get_many<Small>(std::span(keys).subspan(done), std::span(out).subspan(done));
+        ASSERT_GT(served, 0u);
+        ASSERT_LE(served, 4u);
+        for (std::size_t i = done; i < done + served; ++i) {
+            ASSERT_EQ(out[i]->key, keys[i]);
+        }
+        done += served;
+        ++calls;
+    }
+    ASSERT_EQ(calls, 5u);
+    ASSERT_EQ(cache.stats().misses, 20u);
+}
+
+TEST(CacheTest, get_many_hands_out_an_overweight_miss_uncached) {
+    TestCache cache = make_cache(100);
+    const std::vector<std::string> keys = {"a/30", "b/30", "c/30", "d/30", "e/30"};
+    std::vector<Blob *> out(keys.size());
+    ASSERT_EQ(cache.get_many<Blob>(keys, out), 4u);
+    for (std::size_t i = 0; i < 4; ++i) {
+        ASSERT_EQ(out[i]->key, keys[i]);
+    }
+    ASSERT_EQ(cache.size(), 3u);
+    ASSERT_EQ(cache.stats().rejections, 1u);
+}
+
+TEST(CacheTest, get_many_stops_before_a_promotion_spills_over_its_objects) {
+    TestCache cache = make_cache(100);
+    for (const char *key : {"big/60", "big/60", "small/40", "small/40", "hit/10"}) {
+        cache.get<Blob>(key);
+    }
+    // Promoting "hit/10" demotes "big/60", which would push "miss/50" out of the regular segment.
+    const std::vector<std::string> keys = {"miss/50", "hit/10"};
+    std::vector<Blob *> out(keys.size());
+    ASSERT_EQ(cache.get_many<Blob>(keys, out), 1u);
+    ASSERT_EQ(out[0]->key, "miss/50");
+    ASSERT_EQ(cache.stats().evictions, 0u);
+}
+
+TEST(CacheTest, get_many_keeps_random_batches_valid) {
+    TestCache cache = make_cache(64);
+    std::mt19937 random(5);
+    for (int round = 0; round < 300; ++round) {
+        std::vector<std::string> keys;
+        const std::size_t size = 1 + random() % 200;
+        for (std::size_t i = 0; i < size; ++i) {
+            keys.push_back(std::to_string(random() % 150) + "/" + std::to_string(1 + random() % 20));
+        }
+        std::vector<Blob *> out(keys.size());
+        for (std::size_t done = 0; done < keys.size();) {
+            const std::size_t served =
+                cache.get_many<Blob>(std::span(keys).subspan(done), std::span(out).subspan(done));
+            ASSERT_GT(served, 0u);
+            for (std::size_t i = done; i < done + served; ++i) {
+                ASSERT_EQ(out[i]->key, keys[i]);
+            }
+            done += served;
+        }
+        ASSERT_LE(cache.weight(), 128u);
+    }
+}
+
+TEST(CacheTest, snapshot_round_trip) {
+    TestCache cache = make_cache(4);
+    for (const char *key : {"a", "b", "c", "a", "d", "e", "b", "f", "g", "h", "i", "c"}) {
+        cache.get<Small>(key);
+    }
+    const auto path = snapshot_path();
+    cache.save<Small>(path, [](const Small &small) { return small.key; });
+    TestCache restored = make_cache(4);
+    restored.get<Small>("stale");
+    restored.load<Small>(path);
+    ASSERT_EQ(print(restored), print(cache));
+    ASSERT_EQ(restored.size(), cache.size());
+    // Smaller caches keep the most recent entries of each segment.
+    TestCache small = make_cache(2);
+    small.load<Small>(path);
+    ASSERT_EQ(small.size(), 4u);
+    std::filesystem::remove(path);
+}
+
+TEST(CacheTest, snapshot_with_values) {
+    PointCache cache(3, block_size, PoolAllocator::geometric_classes(256));
+    for (int key : {1, 2, 3, 1, 4, 5, 2}) {
+        cache.get<Point>(key).x += 100;
+    }
+    const auto path = snapshot_path();
+    cache.save<Point>(path, [](const Point &point) { return point.key; }, true);
+    PointCache restored(3, block_size, PoolAllocator::geometric_classes(256));
+    restored.load<Point>(path);
+    std::ostringstream expected;
+    std::ostringstream actual;
+    expected << cache;
+    actual << restored;
+    ASSERT_EQ(actual.str(), expected.str());
+    ASSERT_EQ(restored.get<Point>(2).x, 101.0);
+    std::filesystem::remove(path);
+}
+
+TEST(CacheTest, corrupt_snapshot_leaves_cache_intact) {
+    TestCache cache = make_cache(4);
+    for (const char *key : {"a", "b", "c", "a", "d"}) {
+        cache.get<Small>(key);
+    }
+    const auto path = snapshot_path();
+    cache.save<Small>(path, [](const Small &small) { return small.key; });
+    const std::vector<char> good = read_file(path);
+    const std::string before = print(cache);
+    // Magic and version, value size, then the count and the first key length of the priority segment.
+    const std::uint64_t huge = std::uint64_t{1} << 60;
+    const auto corrupt = [&](const std::size_t offset) {
+        std::vector<char> bytes = good;
+        std::memcpy(bytes.data() + offset, &huge, sizeof(huge));
+        return bytes;
+    };
+    std::vector<char> truncated(good.begin(), good.end() - 3);
+    std::vector<char> trailing = good;
+    trailing.push_back(0);
+    std::vector<char> foreign = good;
+    foreign[0] ^= 1;
+    for (const auto &bytes : {corrupt(16), corrupt(24), truncated, trailing, foreign}) {
+        write_file(path, bytes);
+        ASSERT_THROW(cache.load<Small>(path), std::runtime_error);
+        ASSERT_EQ(print(cache), before);
+    }
+    std::filesystem::remove(path);
+    ASSERT_THROW(cache.load<Small>(path), std::runtime_error);
+    ASSERT_EQ(print(cache), before);
+}
+
+TEST(CacheTest, failed_save_keeps_the_previous_snapshot) {
+    TestCache cache = make_cache(4);
+    for (const char *key : {"a", "b", "c", "a"}) {
+        cache.get<Small>(key);
+    }
+    const auto path = snapshot_path();
+    cache.save<Small>(path, [](const Small &small) { return small.key; });
+    const std::vector<char> good = read_file(path);
+    cache.get<Small>("d");
+    // A directory in the way of the temporary file makes the next save fail before it writes anything.
+    auto temporary = path;
+    temporary += ".tmp";
+    std::filesystem::create_directory(temporary);
+    ASSERT_THROW(cache.save<Small>(path, [](const Small &small) { return small.key; }), std::runtime_error);
+    ASSERT_EQ(read_file(path), good);
+    std::filesystem::remove(temporary);
+    cache.save<Small>(path, [](const Small &small) { return small.key; });
+    ASSERT_FALSE(std::filesystem::exists(temporary));
+    TestCache restored = make_cache(4);
+    restored.load<Small>(path);
+    ASSERT_EQ(print(restored), print(cache));
+    std::filesystem::remove(path);
+}
+
+TEST(CacheTest, string_views_find_entries_of_string_keys) {
+    TestCache cache = make_cache(4);
+    const std::string buffer = "a,b";
+    Small &first = cache.get<Small>(std::string_view(buffer).substr(0, 1));
+    ASSERT_EQ(first.key, "a");
+    ASSERT_EQ(&cache.get<Small>(std::string("a")), &first);
+    ASSERT_EQ(&cache.get<Small>(std::string_view(buffer).substr(2)), &cache.get<Small>("b"));
+    ASSERT_EQ(cache.size(), 2u);
+    ASSERT_EQ(cache.stats().misses, 2u);
+}
+
+TEST(CacheTest, same_key_cached_once_per_type) {
+    TestCache cache(4, block_size, TestCache::entry_sizes<Small, Large>());
+    Small &small = cache.get<Small>("k");
+    Large &large = cache.get<Large>("k");
+    ASSERT_NE(static_cast<void *>(&small), static_cast<void *>(&large));
+    ASSERT_EQ(&cache.get<Small>("k"), &small);
+    ASSERT_EQ(&cache.get<Large>("k"), &large);
+    ASSERT_EQ(cache.size(), 2u);
+    ASSERT_EQ(cache.stats().misses, 2u);
+}
+
+TEST(CacheTest, expiry_and_dirty_flags_are_typed) {
+    TestCache cache(4, block_size, TestCache::entry_sizes<Small, Large>());
+    cache.get<Small>("k");
+    cache.get<Large>("k").payload[0] = 'x';
+    std::vector<std::pair<std::string, bool>> removed;
+    cache.set_removal_listener([&](Named &named, RemovalCause, const bool dirty) {
+        removed.emplace_back("untyped " + named.key, dirty);
+    });
+    cache.set_removal_listener<Large>([&](Large &large, RemovalCause, const bool dirty) {
+        removed.emplace_back(std::string("large ") + large.payload[0], dirty);
+    });
+    ASSERT_TRUE(cache.mark_dirty<Large>("k"));
+    ASSERT_FALSE(cache.mark_dirty<Large>("missing"));
+    const auto now = TestCache::Clock::now();
+    ASSERT_TRUE(cache.expire_at<Small>("k", now));
+    ASSERT_EQ(cache.expire(now + std::chrono::seconds(1)), 1u);
+    ASSERT_EQ(removed, (std::vector<std::pair<std::string, bool>>{{"untyped k", false}}));
+    ASSERT_TRUE(cache.expire_at<Large>("k", now));
+    ASSERT_EQ(cache.expire(now + std::chrono::seconds(2)), 1u);
+    ASSERT_EQ(removed.back(), (std::pair<std::string, bool>{"large x", true}));
+    ASSERT_TRUE(cache.empty());
+}
+
+TEST(CacheTest, typed_removal_listeners_can_be_dropped) {
+    TestCache cache(4, block_size, TestCache::entry_sizes<Small, Large>());
+    int typed = 0;
+    int untyped = 0;
+    cache.set_removal_listener([&untyped](Named &, RemovalCause, bool) { ++untyped; });
+    cache.set_removal_listener<Small>([&typed](Small &, RemovalCause, bool) { ++typed; });
+    const auto now = TestCache::Clock::now();
+    for (const char *key : {"a", "b"}) {
+        cache.get<Small>(key);
+        cache.expire_at<Small>(key, now);
+    }
+    cache.expire(now + std::chrono::seconds(1));
+    cache.set_removal_listener<Small>(nullptr);
+    cache.get<Small>("c");
+    cache.expire_at<Small>("c", now);
+    cache.expire(now + std::chrono::seconds(2));
+    ASSERT_EQ(typed, 2);
+    ASSERT_EQ(untyped, 1);
+}
+
+TEST(CacheTest, quota_keeps_large_objects_from_evicting_small_ones) {
+    TestCache cache(4, block_size, TestCache::entry_sizes<Small, Large>());
+    cache.set_quota<Large>(2);
+    for (int i = 0; i < 4; ++i) {
+        cache.get<Small>("s" + std::to_string(i));
+        cache.get<Small>("s" + std::to_string(i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        cache.get<Large>("l" + std::to_string(i));
+    }
+    const std::size_t misses = cache.stats().misses;
+    for (int i = 0; i < 4; ++i) {
+        cache.get<Small>("s" + std::to_string(i));
+    }
+    ASSERT_EQ(cache.stats().misses, misses);
+    ASSERT_EQ(cache.size(), 6u);
+}
+
+TEST(CacheTest, quota_moves_cached_objects_in_order) {
+    TestCache cache(8, block_size, TestCache::entry_sizes<Small, Large>());
+    for (int i = 0; i < 5; ++i) {
+        cache.get<Large>("l" + std::to_string(i));
+    }
+    cache.get<Small>("s");
+    cache.set_quota<Large>(3);
+    // The three most recent objects fit the quota, the older ones are evicted.
+    ASSERT_EQ(cache.size(), 4u);
+    const std::size_t misses = cache.stats().misses;
+    for (const char *key : {"l4", "l3", "l2"}) {
+        cache.get<Large>(key);
+    }
+    cache.get<Small>("s");
+    ASSERT_EQ(cache.stats().misses, misses);
+    cache.get<Large>("l1");
+    ASSERT_EQ(cache.stats().misses, misses + 1);
+}
@@ -0,0 +1,55 @@
+#include <cstddef>
+
+#include "acp/FrequencySketch.hpp"
+#include "gtest/gtest.h"
+
+TEST(FrequencySketchTest, capacity_rounds_up_to_a_power_of_two) {
+    ASSERT_EQ(FrequencySketch(1).capacity(), 16u);
+    ASSERT_EQ(FrequencySketch(100).capacity(), 128u);
+    ASSERT_EQ(FrequencySketch(1024).capacity(), 1024u);
+}
+
+TEST(FrequencySketchTest, counts_records) {
+    FrequencySketch sketch(1024);
+    ASSERT_EQ(sketch.estimate(42), 0u);
+    // The first occurrence only goes to the doorkeeper.
+    sketch.record(42);
+    ASSERT_EQ(sketch.estimate(42), 1u);
+    for (int i = 0; i < 4; ++i) {
+        sketch.record(42);
+    }
+    ASSERT_EQ(sketch.estimate(42), 5u);
+    ASSERT_EQ(sketch.estimate(43), 0u);
+}
+
+TEST(FrequencySketchTest, counters_saturate) {
+    FrequencySketch sketch(1024);
+    for (int i = 0; i < 100; ++i) {
+        sketch.record(7);
+    }
+    ASSERT_EQ(sketch.estimate(7), 16u);
+}
+
+TEST(FrequencySketchTest, ages_after_a_sample) {
+    FrequencySketch sketch(1024);
+    for (int i = 0; i < 10; ++i) {
+        sketch.record(1);
+    }
+    ASSERT_EQ(sketch.estimate(1), 10u);
+    // A sample is ten records per unit of capacity; its last record halves the counters and clears the doorkeeper.
+    for (std::size_t i = 10; i < 10 * 1024; ++i) {
+        sketch.record(2);
+    }
+    ASSERT_EQ(sketch.estimate(1), 4u);
+    ASSERT_EQ(sketch.estimate(2), 7u);
+}
+
+TEST(FrequencySketchTest, admits_more_frequent_candidates) {
+    FrequencySketch sketch(1024);
+    sketch.record(1);
+    sketch.record(2);
+    sketch.record(2);
+    ASSERT_TRUE(sketch.admit(2, 1));
+    ASSERT_FALSE(sketch.admit(1, 2));
+    ASSERT_FALSE(sketch.admit(1, 1));
+}
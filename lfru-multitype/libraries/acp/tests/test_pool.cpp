@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "acp/Pool.hpp"
+#include "gtest/gtest.h"
+
+// The multi-threaded cases are meant to be run under ThreadSanitizer as well.
+
+namespace {
+
+constexpr std::size_t block_size = 1 << 16;
+
+std::size_t slabs_of(PoolAllocator &pool) {
+    std::size_t result = 0;
+    for (const auto &usage : pool.occupancy()) {
+        result += usage.slabs;
+    }
+    return result;
+}
+
+// Fills an object with a pattern identifying its owner, so that two owners handed the same slot show up.
+void stamp(void *ptr, const std::size_t size, const std::uint64_t owner) {
+    auto *words = static_cast<std::uint64_t *>(ptr);
+    std::fill(words, words + size / sizeof(std::uint64_t), owner);
+}
+
+bool has_stamp(const void *ptr, const std::size_t size, const std::uint64_t owner) {
+    const auto *words = static_cast<const std::uint64_t *>(ptr);
+    return std::all_of(words, words + size / sizeof(std::uint64_t), [owner](auto word) { return word == owner; });
+}
+
+// Every thread allocates, checks that nobody else wrote into its objects and hands half of them to the next
+// thread, which frees them: each object is freed on another thread than the one that allocated it.
+void exchange_objects(PoolAllocator &pool, const std::size_t thread_count, const std::size_t rounds) {
+    constexpr std::size_t batch = 200;
+    constexpr std::size_t size = 48;
+    std::vector<std::mutex> locks(thread_count);
+    std::vector<std::vector<void *>> inboxes(thread_count);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<void *> mine;
+            for (std::size_t round = 0; round < rounds; ++round) {
+                for (std::size_t i = 0; i < batch; ++i) {
+                    mine.push_back(pool.allocate(size));
+                    stamp(mine.back(), size, t * rounds + round);
+                }
+                std::this_thread::yield();
+                for (void *ptr : mine) {
+                    ASSERT_TRUE(has_stamp(ptr, size, t * rounds + round));
+                }
+                {
+                    std::lock_guard lock(locks[(t + 1) % thread_count]);
+                    auto &inbox = inboxes[(t + 1) % thread_count];
+                    inbox.insert(inbox.end(), mine.begin() + batch / 2, mine.end());
+                }
+                mine.resize(batch / 2);
+                for (void *ptr : mine) {
+                    pool.deallocate(ptr);
+                }
+                mine.clear();
+                std::vector<void *> received;
+                {
+                    std::lock_guard lock(locks[t]);
+                    received.swap(inboxes[t]);
+                }
+                for (void *ptr : received) {
+                    pool.deallocate(ptr);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &inbox : inboxes) {
+        for (void *ptr : inbox) {
+            pool.deallocate(ptr);
+        }
+    }
+}
+
+}  // namespace
+
+TEST(PoolTest, live_objects_do_not_overlap) {
+    PoolAllocator pool(block_size, {16, 64, 256});
+    std::vector<std::pair<void *, std::size_t>> objects;
+    for (std::size_t i = 0; i < 3000; ++i) {
+        const std::size_t size = 16 << (i % 3 * 2);
+        objects.emplace_back(pool.allocate(size), size);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(objects.back().first) % alignof(void *), 0u);
+        stamp(objects.back().first, size, i);
+    }
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        ASSERT_TRUE(has_stamp(objects[i].first, objects[i].second, i));
+    }
+    for (const auto &object : objects) {
+        pool.deallocate(object.first);
+    }
+}
+
+TEST(PoolTest, requests_round_up_to_size_classes) {
+    PoolAllocator pool(block_size, {24, 48});
+    void *ptr = pool.allocate(30);
+    const auto usage = pool.occupancy();
+    ASSERT_EQ(usage[0].slabs, 0u);
+    ASSERT_EQ(usage[1].size, 48u);
+    ASSERT_EQ(usage[1].slabs, 1u);
+    pool.deallocate(ptr);
+}
+
+TEST(PoolTest, freed_slots_are_reused) {
+    PoolAllocator pool(block_size, {64});
+    std::vector<void *> objects;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 5000; ++i) {
+            objects.push_back(pool.allocate(64));
+        }
+        for (void *ptr : objects) {
+            pool.deallocate(ptr);
+        }
+        objects.clear();
+    }
+    // 5000 slots take six 64 KiB slabs; one more may be kept around for magazine slots.
+    ASSERT_LE(slabs_of(pool), 7u);
+}
+
+TEST(PoolTest, sizes_beyond_listed_classes_stay_in_slabs) {
+    PoolAllocator pool(block_size, {16, 32});
+    std::vector<void *> objects;
+    for (std::uint64_t i = 0; i < 100; ++i) {
+        objects.push_back(pool.allocate(600));
+        stamp(objects.back(), 600, i);
+    }
+    std::size_t slabs = 0;
+    for (const auto &usage : pool.occupancy()) {
+        if (usage.slabs != 0) {
+            ASSERT_GE(usage.size, 600u);
+            ASSERT_LT(usage.size, 1200u);
+            slabs += usage.slabs;
+        }
+    }
+    ASSERT_LE(slabs, 2u);
+    for (std::uint64_t i = 0; i < objects.size(); ++i) {
+        ASSERT_TRUE(has_stamp(objects[i], 600, i));
+        pool.deallocate(objects[i]);
+    }
+}
+
+TEST(PoolTest, objects_larger_than_a_slab) {
+    PoolAllocator pool(block_size, {64});
+    void *whole = pool.allocate(block_size - PoolAllocator::header_size);
+    void *large = pool.allocate(3 * block_size);
+    stamp(whole, block_size - PoolAllocator::header_size, 1);
+    stamp(large, 3 * block_size, 2);
+    ASSERT_TRUE(has_stamp(whole, block_size - PoolAllocator::header_size, 1));
+    ASSERT_TRUE(has_stamp(large, 3 * block_size, 2));
+    pool.deallocate(large);
+    pool.deallocate(whole);
+    ASSERT_THROW(pool.allocate(std::numeric_limits<std::size_t>::max()), std::bad_alloc);
+}
+
+TEST(PoolTest, empty_slabs_are_purged_and_reused) {
+    PoolAllocator pool(block_size, {128}, 4);
+    pool.set_decay_time(std::chrono::steady_clock::duration::zero());
+    std::vector<void *> objects;
+    for (std::uint64_t round = 0; round < 3; ++round) {
+        for (std::uint64_t i = 0; i < 2000; ++i) {
+            objects.push_back(pool.allocate(128));
+            stamp(objects.back(), 128, round * 2000 + i);
+        }
+        for (std::uint64_t i = 0; i < objects.size(); ++i) {
+            ASSERT_TRUE(has_stamp(objects[i], 128, round * 2000 + i));
+            pool.deallocate(objects[i]);
+        }
+        objects.clear();
+    }
+}
+
+TEST(PoolTest, shared_mode_has_to_be_enabled_before_use) {
+    PoolAllocator pool(block_size, {64});
+    pool.deallocate(pool.allocate(64));
+    ASSERT_THROW(pool.enable_shared_mode(), std::logic_error);
+}
+
+TEST(PoolTest, objects_freed_on_other_threads) {
+    PoolAllocator pool(block_size, {48});
+    exchange_objects(pool, 4, 200);
+    // Everything allocated afterwards is still handed out once.
+    std::set<void *> seen;
+    std::vector<void *> objects;
+    for (int i = 0; i < 5000; ++i) {
+        objects.push_back(pool.allocate(48));
+        ASSERT_TRUE(seen.insert(objects.back()).second);
+    }
+    for (void *ptr : objects) {
+        pool.deallocate(ptr);
+    }
+}
+
+TEST(PoolTest, shared_mode_objects_freed_on_other_threads) {
+    PoolAllocator pool(block_size, {48});
+    pool.enable_shared_mode();
+    exchange_objects(pool, 4, 200);
+    std::set<void *> seen;
+    std::vector<void *> objects;
+    for (int i = 0; i < 5000; ++i) {
+        objects.push_back(pool.allocate(48));
+        ASSERT_TRUE(seen.insert(objects.back()).second);
+    }
+    for (void *ptr : objects) {
+        pool.deallocate(ptr);
+    }
+}
+
+TEST(PoolTest, threads_exiting_with_cached_slots) {
+    PoolAllocator pool(block_size, {64});
+    pool.enable_shared_mode();
+    for (int round = 0; round < 20; ++round) {
+        std::thread([&pool] {
+            std::vector<void *> objects;
+            for (int i = 0; i < 100; ++i) {
+                objects.push_back(pool.allocate(64));
+            }
+            for (void *ptr : objects) {
+                pool.deallocate(ptr);
+            }
+        }).join();
+    }
+    std::set<void *> seen;
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_TRUE(seen.insert(pool.allocate(64)).second);
+    }
+    for (void *ptr : seen) {
+        pool.deallocate(ptr);
+    }
+}
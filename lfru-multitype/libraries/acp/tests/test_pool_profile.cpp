@@ -0,0 +1,110 @@
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "acp/Pool.hpp"
+#include "gtest/gtest.h"
+
+// Built against a pool compiled with ACP_POOL_DEBUG, which implies ACP_POOL_STATS.
+
+namespace {
+
+constexpr std::size_t block_size = 1 << 16;
+
+const PoolAllocator::Profile &profile_of(const std::vector<PoolAllocator::Profile> &profile, const std::size_t size) {
+    for (const auto &counters : profile) {
+        if (counters.size == size) {
+            return counters;
+        }
+    }
+    throw std::logic_error("no size class " + std::to_string(size));
+}
+
+// Kept out of line and fed sizes only known at run time, so that its objects share one call site however the loop
+// is compiled.
+[[gnu::noinline]] void leak(PoolAllocator &pool, const std::vector<std::size_t> &sizes) {
+    for (const std::size_t size : sizes) {
+        pool.allocate(size);
+    }
+}
+
+std::size_t occurrences(const std::string &text, const std::string &pattern) {
+    std::size_t count = 0;
+    for (std::size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(PoolProfileTest, counts_per_size_class) {
+    PoolAllocator pool(block_size, {16, 64});
+    std::vector<void *> objects;
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(pool.allocate(i % 4 == 0 ? 60 : 10));
+    }
+    objects.push_back(pool.allocate(3 * block_size));
+
+    auto profile = pool.profile();
+    ASSERT_EQ(profile.back().size, 0u);
+    ASSERT_EQ(profile.back().allocations, 1u);
+    ASSERT_EQ(profile_of(profile, 16).allocations, 750u);
+    ASSERT_EQ(profile_of(profile, 16).live, 750u);
+    ASSERT_EQ(profile_of(profile, 64).live, 250u);
+    ASSERT_GE(profile_of(profile, 16).slabs, 1u);
+
+    for (std::size_t i = 0; i < objects.size(); i += 2) {
+        pool.deallocate(objects[i]);
+    }
+    profile = pool.profile();
+    ASSERT_EQ(profile_of(profile, 16).live, 500u);
+    ASSERT_EQ(profile_of(profile, 16).frees, 250u);
+    ASSERT_EQ(profile_of(profile, 16).peak, 750u);
+    ASSERT_EQ(profile_of(profile, 64).live, 0u);
+    ASSERT_EQ(profile_of(profile, 64).peak, 250u);
+    ASSERT_EQ(profile.back().live, 0u);
+
+    for (std::size_t i = 1; i < objects.size(); i += 2) {
+        pool.deallocate(objects[i]);
+    }
+    for (const auto &counters : pool.profile()) {
+        ASSERT_EQ(counters.live, 0u);
+        ASSERT_EQ(counters.allocations, counters.frees);
+    }
+}
+
+TEST(PoolProfileTest, failed_allocations_are_counted) {
+    PoolAllocator pool(block_size, {64});
+    ASSERT_THROW(pool.allocate(std::numeric_limits<std::size_t>::max()), std::bad_alloc);
+    const auto profile = pool.profile();
+    ASSERT_EQ(profile.back().failures, 1u);
+    ASSERT_EQ(profile.back().allocations, 0u);
+}
+
+TEST(PoolProfileTest, leaks_are_reported_by_call_site) {
+    testing::internal::CaptureStderr();
+    {
+        PoolAllocator pool(block_size, {64});
+        leak(pool, {40, 40, 40});
+        pool.deallocate(pool.allocate(40));
+        pool.allocate(3 * block_size);
+    }
+    const std::string report = testing::internal::GetCapturedStderr();
+    ASSERT_EQ(occurrences(report, "4 objects still live at destruction"), 1u);
+    // Objects allocated from the same place are grouped under one stack.
+    ASSERT_EQ(occurrences(report, "allocated at:"), 2u);
+    ASSERT_EQ(occurrences(report, "3 allocated at:"), 1u);
+    ASSERT_EQ(occurrences(report, "1 allocated at:"), 1u);
+}
+
+TEST(PoolProfileTest, nothing_reported_without_leaks) {
+    testing::internal::CaptureStderr();
+    {
+        PoolAllocator pool(block_size, {64});
+        pool.deallocate(pool.allocate(40));
+    }
+    ASSERT_EQ(testing::internal::GetCapturedStderr(), "");
+}
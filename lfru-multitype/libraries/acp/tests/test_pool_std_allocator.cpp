@@ -0,0 +1,101 @@
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "acp/Pool.hpp"
+#include "acp/PoolStdAllocator.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+constexpr std::size_t block_size = 1 << 16;
+
+// Slots a thread cache may hold on to per size class besides the live objects: a full magazine and a batch of
+// frees not yet handed back to their slabs.
+constexpr std::size_t cached_slots = 32 + 64;
+
+std::size_t used_of(PoolAllocator &pool) {
+    std::size_t result = 0;
+    for (const auto &usage : pool.occupancy()) {
+        result += usage.used;
+    }
+    return result;
+}
+
+template <class K, class V>
+using PoolMap = std::map<K, V, std::less<>, PoolStdAllocator<std::pair<const K, V>>>;
+
+template <class K, class V>
+using PoolHashMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<>, PoolStdAllocator<std::pair<const K, V>>>;
+
+}  // namespace
+
+TEST(PoolStdAllocatorTest, list_nodes_come_from_the_pool) {
+    PoolAllocator pool(block_size, PoolAllocator::geometric_classes(512));
+    {
+        std::list<int, PoolStdAllocator<int>> list{PoolStdAllocator<int>(pool)};
+        for (int i = 0; i < 10000; ++i) {
+            list.push_back(i);
+        }
+        ASSERT_GE(used_of(pool), 10000u);
+        list.remove_if([](const int value) { return value % 2 == 0; });
+        int expected = 1;
+        for (const int value : list) {
+            ASSERT_EQ(value, expected);
+            expected += 2;
+        }
+    }
+    ASSERT_LE(used_of(pool), cached_slots);
+}
+
+TEST(PoolStdAllocatorTest, map_copies_and_moves_stay_in_the_pool) {
+    PoolAllocator pool(block_size, PoolAllocator::geometric_classes(512));
+    PoolMap<int, std::string> map{PoolStdAllocator<std::pair<const int, std::string>>(pool)};
+    for (int i = 0; i < 5000; ++i) {
+        map.emplace(i, std::to_string(i));
+    }
+    PoolMap<int, std::string> copy = map;
+    ASSERT_TRUE(copy.get_allocator() == map.get_allocator());
+    ASSERT_GE(used_of(pool), 10000u);
+
+    PoolMap<int, std::string> moved = std::move(map);
+    ASSERT_EQ(&moved.get_allocator().pool(), &pool);
+    ASSERT_EQ(moved, copy);
+    for (int i = 0; i < 5000; i += 7) {
+        ASSERT_EQ(copy.at(i), std::to_string(i));
+    }
+    copy.clear();
+    moved.clear();
+    ASSERT_LE(used_of(pool), cached_slots);
+}
+
+TEST(PoolStdAllocatorTest, unordered_map_buckets_bypass_the_pool) {
+    PoolAllocator pool(block_size, PoolAllocator::geometric_classes(512));
+    PoolHashMap<int, int> map(16, std::hash<int>{}, std::equal_to<>{},
+                              PoolStdAllocator<std::pair<const int, int>>(pool));
+    for (int i = 0; i < 10000; ++i) {
+        map[i] = i * 2;
+    }
+    for (int i = 0; i < 10000; i += 2) {
+        map.erase(i);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_EQ(map.count(i), static_cast<std::size_t>(i % 2));
+    }
+    // Only the nodes are in the pool: the bucket array, grown by rehashing, comes from operator new.
+    ASSERT_GE(used_of(pool), map.size());
+    ASSERT_LE(used_of(pool), map.size() + cached_slots);
+}
+
+TEST(PoolStdAllocatorTest, rebound_allocators_share_the_pool) {
+    PoolAllocator pool(block_size, {64});
+    PoolAllocator other(block_size, {64});
+    const PoolStdAllocator<int> ints(pool);
+    const PoolStdAllocator<std::string> strings(ints);
+    ASSERT_EQ(&strings.pool(), &pool);
+    ASSERT_TRUE(ints == strings);
+    ASSERT_FALSE(ints == PoolStdAllocator<int>(other));
+}
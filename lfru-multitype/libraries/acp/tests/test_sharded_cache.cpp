@@ -0,0 +1,208 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "acp/Allocator.hpp"
+#include "acp/ShardedCache.hpp"
+#include "gtest/gtest.h"
+
+// These cases are meant to be run under ThreadSanitizer as well.
+
+namespace {
+
+struct Value {
+    std::string key;
+    int loaded_by = -1;
+
+    explicit Value(const std::string &key) : key(key) {}
+
+    Value(const std::string &key, const int loaded_by) : key(key), loaded_by(loaded_by) {}
+
+    bool operator==(const std::string &other) const { return key == other; }
+
+    friend std::ostream &operator<<(std::ostream &strm, const Value &value) { return strm << value.key; }
+};
+
+using TestCache = ShardedCache<std::string, Value, AllocatorWithPool>;
+
+TestCache make_cache(const std::size_t shard_count) {
+    return TestCache(shard_count, 1000, 1 << 16, std::initializer_list<std::size_t>{TestCache::entry_size<Value>()});
+}
+
+void join(std::vector<std::thread> &threads) {
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+TEST(ShardedCacheTest, shard_count_is_a_power_of_two) {
+    ASSERT_EQ(make_cache(1).shard_count(), 1u);
+    ASSERT_EQ(make_cache(5).shard_count(), 8u);
+}
+
+TEST(ShardedCacheTest, concurrent_gets_share_entries) {
+    TestCache cache = make_cache(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&cache, t] {
+            for (int i = 0; i < 2000; ++i) {
+                const std::string key = std::to_string((i * 7 + t) % 300);
+                ASSERT_TRUE(cache.get<Value>(key, [&key](Value &value) { return value == key; }));
+            }
+        });
+    }
+    join(threads);
+    ASSERT_EQ(cache.size(), 300u);
+}
+
+TEST(ShardedCacheTest, get_many_calls_back_for_every_key) {
+    TestCache cache = make_cache(4);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back(std::to_string(i % 60));
+    }
+    std::vector<std::string> seen(keys.size());
+    cache.get_many<Value>(std::span<const std::string>(keys),
+                          [&seen](const std::size_t i, Value &value) { seen[i] = value.key; });
+    ASSERT_EQ(seen, keys);
+    ASSERT_EQ(cache.size(), 60u);
+    ASSERT_EQ(cache.stats().misses, 60u);
+}
+
+TEST(ShardedCacheTest, concurrent_misses_load_once) {
+    TestCache cache = make_cache(4);
+    std::atomic<int> loads{0};
+    const auto loader = [&loads](const std::string &key) {
+        const int load = loads++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return Value(key, load);
+    };
+    std::vector<int> seen(16, -1);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < seen.size(); ++t) {
+        threads.emplace_back([&, t] {
+            seen[t] = cache.get_or_load<Value>("hot", loader, [](Value &value) { return value.loaded_by; });
+        });
+    }
+    join(threads);
+    ASSERT_EQ(loads, 1);
+    for (const int load : seen) {
+        ASSERT_EQ(load, 0);
+    }
+    ASSERT_EQ(cache.size(), 1u);
+}
+
+TEST(ShardedCacheTest, distinct_keys_load_once_each) {
+    TestCache cache = make_cache(4);
+    std::atomic<int> loads{0};
+    const auto loader = [&loads](const std::string &key) {
+        ++loads;
+        return Value(key);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 200; ++i) {
+                const std::string key = "k" + std::to_string(i);
+                ASSERT_TRUE(cache.get_or_load<Value>(key, loader, [&key](Value &value) { return value == key; }));
+            }
+        });
+    }
+    join(threads);
+    ASSERT_EQ(loads, 200);
+    ASSERT_EQ(cache.size(), 200u);
+}
+
+TEST(ShardedCacheTest, failed_load_is_retried_by_a_waiter) {
+    TestCache cache = make_cache(2);
+    std::atomic<int> loads{0};
+    const auto loader = [&loads](const std::string &key) {
+        const int load = loads++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        if (load == 0) {
+            throw std::runtime_error("backend unavailable");
+        }
+        return Value(key, load);
+    };
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            try {
+                ASSERT_EQ(cache.get_or_load<Value>("hot", loader, [](Value &value) { return value.loaded_by; }), 1);
+            } catch (const std::runtime_error &) {
+                ++failures;
+            }
+        });
+    }
+    join(threads);
+    ASSERT_EQ(failures, 1);
+    ASSERT_EQ(loads, 2);
+}
+
+TEST(ShardedCacheTest, loaders_run_outside_the_shard_lock) {
+    TestCache cache = make_cache(1);
+    std::promise<void> second_started;
+    auto first = std::async(std::launch::async, [&] {
+        return cache.get_or_load<Value>(
+            "a",
+            [&](const std::string &key) {
+                // Only returns once a load of another key in the same shard has begun.
+                EXPECT_EQ(second_started.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+                return Value(key);
+            },
+            [](Value &value) { return value.key; });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const std::string second = cache.get_or_load<Value>(
+        "b",
+        [&](const std::string &key) {
+            second_started.set_value();
+            return Value(key);
+        },
+        [](Value &value) { return value.key; });
+    ASSERT_EQ(second, "b");
+    ASSERT_EQ(first.get(), "a");
+    ASSERT_EQ(cache.size(), 2u);
+}
+
+TEST(ShardedCacheTest, get_or_load_async) {
+    TestCache cache = make_cache(4);
+    std::atomic<int> loads{0};
+    const auto loader = [&loads](const std::string &key) {
+        ++loads;
+        return Value(key, 7);
+    };
+    std::vector<std::future<Value>> results;
+    for (int i = 0; i < 8; ++i) {
+        results.push_back(cache.get_or_load_async<Value>("k" + std::to_string(i % 4), loader));
+    }
+    for (int i = 0; i < 8; ++i) {
+        const Value value = results[i].get();
+        ASSERT_EQ(value.key, "k" + std::to_string(i % 4));
+        ASSERT_EQ(value.loaded_by, 7);
+    }
+    ASSERT_EQ(loads, 4);
+    ASSERT_EQ(cache.size(), 4u);
+}
+
+TEST(ShardedCacheTest, typed_removal_listener_reaches_every_shard) {
+    TestCache cache(4, 8, 1 << 16, std::initializer_list<std::size_t>{TestCache::entry_size<Value>()});
+    std::vector<std::string> evicted;
+    cache.set_removal_listener<Value>([&evicted](Value &value, const RemovalCause cause, bool) {
+        if (cause == RemovalCause::Evicted) {
+            evicted.push_back(value.key);
+        }
+    });
+    for (int i = 0; i < 200; ++i) {
+        cache.get<Value>(std::to_string(i), [](Value &) { return 0; });
+    }
+    ASSERT_EQ(evicted.size() + cache.size(), 200u);
+}
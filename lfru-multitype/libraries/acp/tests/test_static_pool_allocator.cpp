@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "acp/Allocator.hpp"
+#include "acp/Cache.hpp"
+#include "acp/StaticPoolAllocator.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+struct Named {
+    std::string key;
+
+    explicit Named(std::string_view key) : key(key) {}
+
+    bool operator==(std::string_view other) const { return key == other; }
+
+    friend std::ostream &operator<<(std::ostream &strm, const Named &named) { return strm << named.key; }
+};
+
+struct Triple {
+    std::uint64_t a, b, c;
+};
+
+// Counts its live instances, so that destroy() can be seen to run the destructor.
+struct Counted {
+    static inline int live = 0;
+
+    Counted() { ++live; }
+
+    ~Counted() { --live; }
+
+    Counted(const Counted &) = delete;
+    Counted &operator=(const Counted &) = delete;
+};
+
+using SmallPool = StaticPoolAllocator<1 << 16, 16, 32, 64>;
+
+std::size_t used_of(SmallPool &pool, const std::size_t size) {
+    for (const auto &usage : pool.occupancy()) {
+        if (usage.size == size) {
+            return usage.used;
+        }
+    }
+    return 0;
+}
+
+// Only there to learn the entry size, which does not depend on the allocator.
+using Sizing = Cache<std::string, Named, StaticPoolAllocator<1 << 16, 8>, StringHash>;
+
+using TestCache = Cache<std::string, Named, StaticPoolAllocator<1 << 16, Sizing::entry_size<Named>()>, StringHash>;
+
+using DynamicCache = Cache<std::string, Named, AllocatorWithPool, StringHash>;
+
+template <class C>
+std::string print(const C &cache) {
+    std::ostringstream strm;
+    strm << cache;
+    return strm.str();
+}
+
+}  // namespace
+
+TEST(StaticPoolAllocatorTest, objects_go_to_the_class_of_their_type) {
+    SmallPool pool;
+    auto *number = pool.create<std::uint64_t>(5u);
+    auto *triple = pool.create<Triple>(Triple{1, 2, 3});
+    ASSERT_EQ(*number, 5u);
+    ASSERT_EQ(triple->c, 3u);
+    // Thread caches take whole batches of slots, so only the classes that were used hold any.
+    ASSERT_GT(used_of(pool, 16), 0u);
+    ASSERT_GT(used_of(pool, 32), 0u);
+    ASSERT_EQ(used_of(pool, 64), 0u);
+    pool.destroy<std::uint64_t>(number);
+    pool.destroy<Triple>(triple);
+}
+
+TEST(StaticPoolAllocatorTest, destroy_runs_the_destructor) {
+    SmallPool pool;
+    std::vector<Counted *> objects;
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(pool.create<Counted>());
+    }
+    ASSERT_EQ(Counted::live, 1000);
+    for (Counted *object : objects) {
+        pool.destroy<Counted>(object);
+    }
+    ASSERT_EQ(Counted::live, 0);
+}
+
+TEST(StaticPoolAllocatorTest, backs_a_cache_like_the_dynamic_pool) {
+    TestCache cache(3);
+    DynamicCache expected(3, 1 << 16, PoolAllocator::geometric_classes(1024));
+    for (const char *key : {"a", "b", "a", "c", "d", "e", "b", "f", "a"}) {
+        ASSERT_EQ(cache.get<Named>(key).key, key);
+        expected.get<Named>(key);
+    }
+    ASSERT_EQ(print(cache), print(expected));
+    ASSERT_EQ(&cache.get<Named>("b"), &cache.get<Named>("b"));
+}
@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "acp/TimerWheel.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+struct Timer {
+    std::uint64_t expires = 0;
+    Timer *timer_prev = nullptr;
+    Timer *timer_next = nullptr;
+    std::uint16_t timer_slot = 0;
+    std::uint64_t expired_at = 0;
+};
+
+// Advances the wheel and records when each timer went off, checking that none goes off early.
+void advance(TimerWheel<Timer> &wheel, const std::uint64_t target) {
+    wheel.advance(target, [&wheel](Timer *timer) {
+        ASSERT_LE(timer->expires, wheel.now());
+        ASSERT_EQ(timer->timer_slot, 0u);
+        timer->expired_at = wheel.now();
+    });
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, empty) {
+    TimerWheel<Timer> wheel;
+    ASSERT_TRUE(wheel.empty());
+    advance(wheel, 1000);
+    ASSERT_EQ(wheel.now(), 1000u);
+}
+
+TEST(TimerWheelTest, expires_at_its_tick) {
+    TimerWheel<Timer> wheel;
+    std::vector<Timer> timers(10);
+    for (std::size_t i = 0; i < timers.size(); ++i) {
+        timers[i].expires = 5 + 3 * i;
+        wheel.schedule(&timers[i]);
+    }
+    ASSERT_EQ(wheel.size(), timers.size());
+    for (std::uint64_t tick = 1; tick <= 40; ++tick) {
+        advance(wheel, tick);
+    }
+    ASSERT_TRUE(wheel.empty());
+    for (const Timer &timer : timers) {
+        ASSERT_EQ(timer.expired_at, timer.expires);
+    }
+}
+
+TEST(TimerWheelTest, due_timer_goes_off_on_next_tick) {
+    TimerWheel<Timer> wheel;
+    advance(wheel, 100);
+    Timer timer;
+    timer.expires = 50;
+    wheel.schedule(&timer);
+    advance(wheel, 100);
+    ASSERT_EQ(timer.expired_at, 0u);
+    advance(wheel, 101);
+    ASSERT_EQ(timer.expired_at, 101u);
+}
+
+TEST(TimerWheelTest, cascades_through_levels) {
+    TimerWheel<Timer> wheel;
+    // One timer on each of the first four levels, plus ones right at and behind level boundaries.
+    std::vector<std::uint64_t> expiries = {7, 64, 65, 130, 64 * 64 - 1, 64 * 64, 64 * 64 + 5, 64 * 64 * 64 + 3};
+    std::vector<Timer> timers(expiries.size());
+    for (std::size_t i = 0; i < timers.size(); ++i) {
+        timers[i].expires = expiries[i];
+        wheel.schedule(&timers[i]);
+    }
+    // A single large advance still fires every timer it passes at the timer's own tick.
+    advance(wheel, 64 * 64 + 4);
+    for (std::size_t i = 0; i + 2 < timers.size(); ++i) {
+        ASSERT_EQ(timers[i].expired_at, timers[i].expires);
+    }
+    ASSERT_EQ(wheel.size(), 2u);
+    advance(wheel, 64 * 64 + 5);
+    ASSERT_EQ(timers[6].expired_at, 64u * 64 + 5);
+    advance(wheel, 64 * 64 * 64 + 2);
+    ASSERT_EQ(timers[7].expired_at, 0u);
+    advance(wheel, 64 * 64 * 64 + 3);
+    ASSERT_EQ(timers[7].expired_at, 64u * 64 * 64 + 3);
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, far_future_expiry) {
+    TimerWheel<Timer> wheel;
+    advance(wheel, 12345);
+    Timer far;
+    far.expires = std::uint64_t{1} << 62;
+    Timer farthest;
+    farthest.expires = std::numeric_limits<std::uint64_t>::max();
+    wheel.schedule(&far);
+    wheel.schedule(&farthest);
+    advance(wheel, far.expires - 1);
+    ASSERT_EQ(far.expired_at, 0u);
+    advance(wheel, far.expires);
+    ASSERT_EQ(far.expired_at, far.expires);
+    advance(wheel, farthest.expires - 1);
+    ASSERT_EQ(farthest.expired_at, 0u);
+    advance(wheel, farthest.expires);
+    ASSERT_EQ(farthest.expired_at, farthest.expires);
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, cancelled_timers_never_expire) {
+    TimerWheel<Timer> wheel;
+    std::vector<Timer> timers(100);
+    for (std::size_t i = 0; i < timers.size(); ++i) {
+        timers[i].expires = 1 + i * 97;
+        wheel.schedule(&timers[i]);
+    }
+    for (std::size_t i = 0; i < timers.size(); i += 2) {
+        wheel.cancel(&timers[i]);
+        ASSERT_EQ(timers[i].timer_slot, 0u);
+    }
+    // Cancelling twice is harmless.
+    wheel.cancel(&timers[0]);
+    ASSERT_EQ(wheel.size(), timers.size() / 2);
+    advance(wheel, 100 * 97);
+    for (std::size_t i = 0; i < timers.size(); ++i) {
+        ASSERT_EQ(timers[i].expired_at, i % 2 == 0 ? 0 : timers[i].expires);
+    }
+}
+
+TEST(TimerWheelTest, random_schedule_cancel_and_advance) {
+    std::mt19937_64 random(7);
+    TimerWheel<Timer> wheel;
+    std::vector<Timer> timers(2000);
+    std::uint64_t now = 0;
+    for (int step = 0; step < 50000; ++step) {
+        Timer &timer = timers[random() % timers.size()];
+        switch (random() % 3) {
+            case 0:
+                if (timer.timer_slot == 0) {
+                    const unsigned range = random() % 5 == 0 ? 1 + random() % 30 : 9;
+                    timer.expires = now + 1 + random() % (std::uint64_t{1} << range);
+                    timer.expired_at = 0;
+                    wheel.schedule(&timer);
+                }
+                break;
+            case 1:
+                wheel.cancel(&timer);
+                break;
+            default:
+                now += random() % 5 == 0 ? random() % 100000 : random() % 16;
+                advance(wheel, now);
+                break;
+        }
+    }
+    for (const Timer &timer : timers) {
+        if (timer.timer_slot != 0) {
+            ASSERT_GT(timer.expires, now);
+        } else if (timer.expired_at != 0) {
+            ASSERT_EQ(timer.expired_at, timer.expires);
+        }
+    }
+}
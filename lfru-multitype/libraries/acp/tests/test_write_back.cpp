@@ -0,0 +1,172 @@
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "acp/Allocator.hpp"
+#include "acp/Cache.hpp"
+#include "acp/WriteBack.hpp"
+#include "gtest/gtest.h"
+
+// These cases are meant to be run under ThreadSanitizer as well.
+
+namespace {
+
+// Collects what the writer was handed; the first call waits until released, so that items pile up behind it.
+class Store {
+public:
+    Store() : m_started_future(m_started.get_future()), m_release_future(m_release.get_future().share()) {}
+
+    void write(std::span<int> items) {
+        std::unique_lock lock(m_lock);
+        const bool first = m_batches.empty();
+        m_batches.emplace_back(items.begin(), items.end());
+        lock.unlock();
+        if (first) {
+            m_started.set_value();
+            m_release_future.wait();
+        }
+    }
+
+    void wait_until_started() { m_started_future.wait(); }
+
+    void release() { m_release.set_value(); }
+
+    std::vector<std::vector<int>> batches() {
+        std::lock_guard lock(m_lock);
+        return m_batches;
+    }
+
+    std::vector<int> items() {
+        std::vector<int> result;
+        for (const auto &batch : batches()) {
+            result.insert(result.end(), batch.begin(), batch.end());
+        }
+        return result;
+    }
+
+private:
+    std::mutex m_lock;
+    std::vector<std::vector<int>> m_batches;
+    std::promise<void> m_started;
+    std::future<void> m_started_future;
+    std::promise<void> m_release;
+    std::shared_future<void> m_release_future;
+};
+
+std::vector<int> iota(const int count) {
+    std::vector<int> result;
+    for (int i = 0; i < count; ++i) {
+        result.push_back(i);
+    }
+    return result;
+}
+
+struct Record {
+    std::string key;
+    int value = 0;
+
+    explicit Record(std::string_view key) : key(key) {}
+
+    bool operator==(std::string_view other) const { return key == other; }
+
+    friend std::ostream &operator<<(std::ostream &strm, const Record &record) { return strm << record.key; }
+};
+
+using TestCache = Cache<std::string, Record, AllocatorWithPool, StringHash>;
+
+}  // namespace
+
+TEST(WriteBackTest, items_queued_behind_a_write_are_batched) {
+    Store store;
+    WriteBack<int> write_back(100, 4, [&store](std::span<int> items) { store.write(items); });
+    write_back.push(0);
+    store.wait_until_started();
+    for (int i = 1; i < 11; ++i) {
+        write_back.push(i);
+    }
+    ASSERT_EQ(write_back.pending(), 10u);
+    store.release();
+    write_back.flush();
+    ASSERT_EQ(write_back.pending(), 0u);
+    ASSERT_EQ(store.items(), iota(11));
+    const auto batches = store.batches();
+    ASSERT_EQ(batches.size(), 4u);
+    for (std::size_t i = 1; i < batches.size(); ++i) {
+        ASSERT_EQ(batches[i].size(), i < 3 ? 4u : 2u);
+    }
+}
+
+TEST(WriteBackTest, flush_waits_for_the_write_in_progress) {
+    Store store;
+    WriteBack<int> write_back(10, 10, [&store](std::span<int> items) { store.write(items); });
+    write_back.push(0);
+    store.wait_until_started();
+    auto flushed = std::async(std::launch::async, [&write_back] { write_back.flush(); });
+    // The queue is empty, but the only item has not been written yet.
+    ASSERT_EQ(flushed.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+    store.release();
+    flushed.get();
+    ASSERT_EQ(store.items(), iota(1));
+}
+
+TEST(WriteBackTest, destructor_writes_what_is_still_queued) {
+    Store store;
+    {
+        WriteBack<int> write_back(1000, 16, [&store](std::span<int> items) { store.write(items); });
+        write_back.push(0);
+        store.wait_until_started();
+        for (int i = 1; i < 500; ++i) {
+            write_back.push(i);
+        }
+        store.release();
+    }
+    ASSERT_EQ(store.items(), iota(500));
+}
+
+TEST(WriteBackTest, try_push_never_waits_and_counts_overflows) {
+    Store store;
+    WriteBack<int> write_back(2, 4, [&store](std::span<int> items) { store.write(items); });
+    write_back.push(0);
+    store.wait_until_started();
+    int item = 1;
+    ASSERT_TRUE(write_back.try_push(item));
+    item = 2;
+    ASSERT_TRUE(write_back.try_push(item));
+    item = 3;
+    ASSERT_FALSE(write_back.try_push(item));
+    ASSERT_EQ(item, 3);
+    ASSERT_EQ(write_back.overflows(), 1u);
+    store.release();
+    write_back.flush();
+    ASSERT_EQ(store.items(), iota(3));
+}
+
+TEST(WriteBackTest, removal_listener_falls_back_when_the_queue_is_full) {
+    Store store;
+    WriteBack<int> write_back(4, 4, [&store](std::span<int> items) { store.write(items); });
+    write_back.push(-1);
+    store.wait_until_started();
+    std::vector<int> written_in_place;
+    TestCache cache(4, 1 << 16, PoolAllocator::geometric_classes(256));
+    cache.set_removal_listener([&](Record &record, RemovalCause, const bool dirty) {
+        if (dirty && !write_back.try_push(record.value)) {
+            written_in_place.push_back(record.value);
+        }
+    });
+    // With the writer stuck, evicting a hundred dirty objects may only ever wait on the cache itself.
+    for (int i = 0; i < 100; ++i) {
+        const std::string key = std::to_string(i);
+        cache.get<Record>(key).value = i;
+        cache.mark_dirty<Record>(key);
+    }
+    const std::size_t evicted = cache.stats().evictions;
+    ASSERT_EQ(write_back.pending() + written_in_place.size(), evicted);
+    ASSERT_EQ(write_back.overflows(), written_in_place.size());
+    store.release();
+    write_back.flush();
+    ASSERT_EQ(store.items().size() + written_in_place.size(), evicted + 1);
+}
@@ -1,5 +1,17 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "acp/Allocator.hpp"
 #include "acp/Cache.hpp"
@@ -10,26 +22,266 @@ struct String {
     std::string data;
     bool marked{false};
 
-    String(std::string const& key) : data(key) {}
+    String(std::string_view key) : data(key) {}
 
-    bool operator==(std::string const& other) const { return data == other; }
+    bool operator==(std::string_view other) const { return data == other; }
 
     [[maybe_unused]] friend std::ostream& operator<<(std::ostream& strm, String const& str) { return strm << str.data; }
 };
 
-using TestCache = Cache<std::string, String, AllocatorWithPool>;
+using TestCache = Cache<std::string, String, AllocatorWithPool, StringHash>;
 
-}  // anonymous namespace
+constexpr std::size_t block_size = 1 << 16;
+
+// Every that many operations one is timed on its own for the latency percentiles, the rest only as a whole.
+constexpr std::size_t latency_sample = 64;
 
-int main() {
-    TestCache cache(9, 18 * sizeof(String), std::initializer_list<std::size_t>{sizeof(String)});
+int run_interactive() {
+    TestCache cache(9, 18 * TestCache::entry_size<String>(),
+                    std::initializer_list<std::size_t>{TestCache::entry_size<String>()});
     std::string line;
     while (std::getline(std::cin, line)) {
         auto& s = cache.get<String>(line);
         if (s.marked) {
-            std::cout << "known" << std::endl;
+            std::cout << "known\n";
         }
         s.marked = true;
     }
     std::cout << "\n" << cache << std::endl;
+    return 0;
+}
+
+std::vector<std::string> split(std::string const& value, char const delimiter) {
+    std::vector<std::string> result;
+    std::stringstream strm(value);
+    std::string item;
+    while (std::getline(strm, item, delimiter)) {
+        result.push_back(item);
+    }
+    return result;
+}
+
+// Unlike std::stoul and std::stod these reject trailing garbage and negative counts, and name the bad value.
+std::size_t parse_count(std::string const& value) {
+    std::size_t end = 0;
+    try {
+        if (!value.empty() && value.front() != '-') {
+            std::size_t const count = std::stoul(value, &end);
+            if (end == value.size()) {
+                return count;
+            }
+        }
+    } catch (std::logic_error const&) {
+    }
+    throw std::invalid_argument("invalid count '" + value + "'");
+}
+
+double parse_exponent(std::string const& value) {
+    std::size_t end = 0;
+    try {
+        double const exponent = std::stod(value, &end);
+        if (end == value.size() && exponent >= 0) {
+            return exponent;
+        }
+    } catch (std::logic_error const&) {
+    }
+    throw std::invalid_argument("invalid exponent '" + value + "'");
+}
+
+class Zipf {
+public:
+    Zipf(std::size_t const keys, double const alpha) : m_cdf(keys) {
+        double sum = 0;
+        for (std::size_t i = 0; i < keys; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), alpha);
+            m_cdf[i] = sum;
+        }
+        for (double& value : m_cdf) {
+            value /= sum;
+        }
+    }
+
+    template <class Random>
+    std::size_t operator()(Random& random) {
+        double const point = std::uniform_real_distribution<double>(0, 1)(random);
+        return std::min<std::size_t>(std::lower_bound(m_cdf.begin(), m_cdf.end(), point) - m_cdf.begin(),
+                                     m_cdf.size() - 1);
+    }
+
+private:
+    std::vector<double> m_cdf;
+};
+
+// A trace is either a file with one key per line or a generator spec:
+//   zipf:KEYS:ALPHA:COUNT  Zipf-distributed over KEYS keys
+//   loop:KEYS:COUNT        KEYS keys cycled in order
+//   scan:KEYS:COUNT        Zipf(0.99) over KEYS keys, every other access a never repeated key
+std::vector<std::string> load_trace(std::string const& spec) {
+    std::vector<std::string> trace;
+    auto const parts = split(spec, ':');
+    std::mt19937_64 random(42);
+    bool const generated = (parts.size() == 4 && parts[0] == "zipf") ||
+                           (parts.size() == 3 && (parts[0] == "loop" || parts[0] == "scan"));
+    std::size_t const keys = generated ? parse_count(parts[1]) : 0;
+    if (generated && keys == 0) {
+        throw std::invalid_argument("trace " + spec + " has no keys");
+    }
+    if (parts.size() == 4 && parts[0] == "zipf") {
+        Zipf zipf(keys, parse_exponent(parts[2]));
+        for (std::size_t i = 0, count = parse_count(parts[3]); i < count; ++i) {
+            trace.push_back(std::to_string(zipf(random)));
+        }
+    } else if (parts.size() == 3 && parts[0] == "loop") {
+        for (std::size_t i = 0, count = parse_count(parts[2]); i < count; ++i) {
+            trace.push_back(std::to_string(i % keys));
+        }
+    } else if (parts.size() == 3 && parts[0] == "scan") {
+        Zipf zipf(keys, 0.99);
+        for (std::size_t i = 0, count = parse_count(parts[2]); i < count; ++i) {
+            trace.push_back(i % 2 == 0 ? std::to_string(zipf(random)) : "scan" + std::to_string(i));
+        }
+    } else {
+        std::ifstream file(spec);
+        if (!file) {
+            throw std::runtime_error("cannot open trace " + spec);
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            trace.push_back(line);
+        }
+    }
+    return trace;
+}
+
+struct Policy {
+    std::string name;
+    bool admission;
+    bool adaptive;
+};
+
+std::vector<Policy> const policies = {
+    {"lfru", false, false},
+    {"tinylfu", true, false},
+    {"adaptive", false, true},
+    {"tinylfu+adaptive", true, true},
+};
+
+void run_benchmark(std::string const& name, int const name_width, std::vector<std::string> const& trace,
+                   std::size_t const cache_size, Policy const& policy) {
+    TestCache cache(cache_size, block_size, PoolAllocator::geometric_classes(1024));
+    cache.enable_admission_filter(policy.admission);
+    cache.enable_adaptive_split(policy.adaptive);
+    std::vector<std::uint32_t> latencies;
+    latencies.reserve(trace.size() / latency_sample + 1);
+    // ns/op leaves out the sampled operations, so that it carries no clock overhead.
+    std::chrono::steady_clock::duration sampled{};
+    auto const start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < trace.size(); ++i) {
+        if (i % latency_sample != 0) {
+            cache.get<String>(trace[i]).marked = true;
+            continue;
+        }
+        auto const before = std::chrono::steady_clock::now();
+        cache.get<String>(trace[i]).marked = true;
+        auto const elapsed = std::chrono::steady_clock::now() - before;
+        sampled += elapsed;
+        latencies.push_back(
+            static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    auto const total = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start - sampled);
+    std::size_t const batched = trace.size() - latencies.size();
+    auto const p99 = latencies.begin() + static_cast<std::ptrdiff_t>(latencies.size() * 99 / 100);
+    std::nth_element(latencies.begin(), p99, latencies.end());
+    std::cout << std::left << std::setw(name_width) << name << std::setw(18) << policy.name << std::right
+              << std::setw(10) << cache_size << std::fixed << std::setprecision(4) << std::setw(10)
+              << cache.stats().hit_ratio() << std::setprecision(1) << std::setw(10)
+              << (batched == 0 ? 0.0 : total.count() / static_cast<double>(batched)) << std::setw(10)
+              << (latencies.empty() ? 0 : *p99) << "\n";
+    for (auto const& usage : cache.allocator().occupancy()) {
+        if (usage.slabs != 0) {
+            std::cout << "    size class " << usage.size << ": " << usage.slabs << " slabs, " << usage.used << " / "
+                      << usage.capacity << " slots\n";
+        }
+    }
+#ifdef ACP_POOL_STATS
+    for (auto const& counters : cache.allocator().profile()) {
+        if (counters.allocations != 0) {
+            std::cout << "    size class " << counters.size << ": " << counters.allocations << " allocations, "
+                      << counters.frees << " frees, peak " << counters.peak << ", " << counters.failures
+                      << " failures\n";
+        }
+    }
+#endif
+}
+
+int usage(char const* program) {
+    std::cerr << "usage: " << program << " [--sizes N,N,...] [--policy lfru|tinylfu|adaptive|tinylfu+adaptive] trace...\n"
+              << "trace: file with one key per line, zipf:KEYS:ALPHA:COUNT, loop:KEYS:COUNT or scan:KEYS:COUNT\n"
+              << "without arguments keys are read from stdin and repeated ones are reported as known\n";
+    return 1;
+}
+
+int run(int argc, char** argv) {
+    std::vector<std::size_t> sizes = {1000};
+    std::vector<Policy> selected = policies;
+    std::vector<std::string> traces;
+    for (int i = 1; i < argc; ++i) {
+        std::string const arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            for (auto const& size : split(argv[++i], ',')) {
+                sizes.push_back(parse_count(size));
+            }
+        } else if (arg == "--policy" && i + 1 < argc) {
+            std::string const name = argv[++i];
+            selected.clear();
+            std::copy_if(policies.begin(), policies.end(), std::back_inserter(selected),
+                         [&name](Policy const& policy) { return policy.name == name; });
+            if (selected.empty()) {
+                return usage(argv[0]);
+            }
+        } else if (arg.starts_with("--")) {
+            return usage(argv[0]);
+        } else {
+            traces.push_back(arg);
+        }
+    }
+    if (traces.empty()) {
+        return usage(argv[0]);
+    }
+    // Wide enough for the longest spec plus a space.
+    std::size_t name_width = 24;
+    for (auto const& spec : traces) {
+        name_width = std::max(name_width, spec.size() + 1);
+    }
+    for (auto const& spec : traces) {
+        auto const trace = load_trace(spec);
+        // Only once the first trace loaded, so that a bad spec leaves nothing but the error on stdout.
+        if (&spec == &traces.front()) {
+            std::cout << std::left << std::setw(static_cast<int>(name_width)) << "trace" << std::setw(18) << "policy"
+                      << std::right << std::setw(10) << "size" << std::setw(10) << "hit ratio" << std::setw(10)
+                      << "ns/op" << std::setw(10) << "p99 ns" << "\n";
+        }
+        for (std::size_t size : sizes) {
+            for (auto const& policy : selected) {
+                run_benchmark(spec, static_cast<int>(name_width), trace, size, policy);
+            }
+        }
+    }
+    return 0;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        return run_interactive();
+    }
+    // Bad numbers and unreadable traces end up here rather than in std::terminate.
+    try {
+        return run(argc, argv);
+    } catch (std::exception const& e) {
+        std::cerr << argv[0] << ": " << e.what() << "\n";
+        return usage(argv[0]);
+    }
 }